@@ -3,6 +3,8 @@
 #include "core.h"
 #include "list.h"
 
+#include <atomic>
+
 enum chess_piece_type : uint8_t
 {
   cpT_none, // `none` has to always be 0 for easy checks.
@@ -68,6 +70,9 @@ struct chess_board
   uint8_t isWhitesTurn : 1 = true;
   uint8_t hasWhiteWon : 1 = false;
   uint8_t hasBlackWon : 1 = false;
+  uint8_t halfMoveClock = 0; // plies since the last capture or pawn move (saturating).
+  uint64_t hash = 0; // Zobrist key of the position (pieces, side to move, castling rights & en passant). Kept up to date by `perform_move` and the board creation functions.
+  uint64_t pawnHash = 0; // Zobrist key of the pawns only. Kept up to date by `perform_move` and the board creation functions.
 
   chess_piece &operator[](const vec2i8 pos)
   {
@@ -149,7 +154,7 @@ struct chess_move
     lsAssert(target.x >= 0 && target.x < BoardWidth && target.y >= 0 && target.y < BoardWidth);
   }
 
-  bool operator ==(const chess_move other)
+  bool operator ==(const chess_move other) const
   {
     return startX == other.startX && startY == other.startY && targetX == other.targetX && targetY == other.targetY && isPromotion == other.isPromotion && (!isPromotion || (isPromotedToQueen == other.isPromotedToQueen));
   }
@@ -164,6 +169,20 @@ chess_board perform_move(const chess_board &board, const chess_move move);
 
 //////////////////////////////////////////////////////////////////////////
 
+constexpr size_t FiftyMoveRulePlies = 100;
+
+// Keys of the positions that were played before the current one, so the search can detect repetitions.
+struct chess_history
+{
+  list<uint64_t> hashes;
+};
+
+// Call this with the board a move is about to be performed on. Positions that can no longer be repeated are dropped.
+lsResult chess_history_add(chess_history &history, const chess_board &board);
+void chess_history_clear(chess_history &history);
+
+//////////////////////////////////////////////////////////////////////////
+
 struct chess_hash_board
 {
   uint8_t nibbleMap[8 * 4];
@@ -224,14 +243,106 @@ void starting_hash_boards_create();
 
 //////////////////////////////////////////////////////////////////////////
 
+constexpr size_t TranspositionTableDefaultEntryCountBits = 22;
+
+// The table is shared by all searches. None of these may be called while a search is running, as they may release the memory it's probing.
+lsResult transposition_table_create(const size_t entryCountBits = TranspositionTableDefaultEntryCountBits);
+void transposition_table_destroy();
+void transposition_table_clear();
+
+// Snapshots can only be loaded into a table of the same size (or if no table has been created yet).
+lsResult transposition_table_save(const char *filename);
+lsResult transposition_table_load(const char *filename);
+
+struct transposition_table_stats
+{
+  size_t probes = 0;
+  size_t hits = 0; // probes that found an entry of the same position.
+  size_t cutoffs = 0; // hits that were deep enough and had a usable bound to end the search of the node.
+  size_t stores = 0;
+  size_t replacements = 0; // stores that overwrote the entry of another position.
+  size_t collisions = 0; // probes that found the slot occupied by another position.
+  size_t hashfullPermille = 0; // occupied slots, sampled from the start of the table.
+};
+
+// The counters accumulate over all searches since the table was created or loaded.
+transposition_table_stats transposition_table_get_stats();
+void transposition_table_reset_stats();
+
+//////////////////////////////////////////////////////////////////////////
+
 int64_t evaluate_chess_board(const chess_board &board);
 
+//////////////////////////////////////////////////////////////////////////
+
+constexpr size_t DefaultSearchDepth = 6;
+constexpr size_t MaxSearchDepth = 32;
+
+enum search_parallel_mode : uint8_t
+{
+  spm_lazy_smp, // every thread searches the whole tree on the shared transposition table. Scales with long searches.
+  spm_root_split, // once the first root move is searched, the others are distributed among the threads. Pays off sooner, so it suits short searches.
+  spm_abdada, // like Lazy SMP, but threads defer moves into subtrees another thread is already searching, so they split the work of each node instead of repeating it.
+};
+
+// Deadlines are `lsGetCurrentTimeNs` timestamps. Zero means unlimited for all of the limits.
+struct search_limits
+{
+  size_t maxDepth = DefaultSearchDepth;
+  size_t maxNodes = 0; // unlike time limits, the same node budget leads to the same result for the same position, but only from a cleared transposition table and after `search_caches_clear`, as the search threads learn from earlier searches.
+  int64_t maxTimeMs = 0; // fills in the deadlines that aren't set explicitly: the soft one at half of the time, the hard one at all of it.
+  int64_t softDeadlineNs = 0; // no further iteration is started after this point.
+  int64_t hardDeadlineNs = 0; // the running iteration is aborted at this point.
+  std::atomic<bool> *pStop = nullptr; // may be set from any thread to abort the search.
+  size_t multiPv = 1; // how many of the best root moves to search lines for, up to `MaxMultiPv`.
+  size_t threads = 1; // up to `MaxSearchThreads`. With more than one thread, the results are no longer deterministic. Searches with a node budget only use multiple threads with `spm_root_split`, whose threads take their nodes from the budget in chunks until all of it is used up.
+  search_parallel_mode parallelMode = spm_lazy_smp; // how the threads share the work.
+};
+
+constexpr size_t MaxSearchThreads = 64;
+
+constexpr size_t MaxMultiPv = 8;
+
+struct search_line
+{
+  int32_t score = 0; // relative to the side to move.
+  chess_move pv[MaxSearchDepth]; // the expected line, starting with the root move.
+  size_t pvLength = 0;
+};
+
+// The outcome of the last completed iteration of a search.
+struct search_result
+{
+  size_t depth = 0;
+  size_t nodes = 0; // of the whole search, including an aborted iteration.
+  search_line lines[MaxMultiPv]; // best first. Each line starts with a different root move.
+  size_t lineCount = 0;
+};
+
 chess_move get_minimax_move_white(const chess_board &board);
 chess_move get_minimax_move_black(const chess_board &board);
-chess_move get_alpha_beta_move_white(const chess_board &board);
-chess_move get_alpha_beta_move_black(const chess_board &board);
-chess_move get_complex_move_white(const chess_board &board);
-chess_move get_complex_move_black(const chess_board &board);
+chess_move get_alpha_beta_move_white(const chess_board &board, const chess_history *pHistory = nullptr);
+chess_move get_alpha_beta_move_black(const chess_board &board, const chess_history *pHistory = nullptr);
+chess_move get_complex_move_white(const chess_board &board, const chess_history *pHistory = nullptr, const search_limits *pLimits = nullptr, _Out_opt_ search_result *pResult = nullptr);
+chess_move get_complex_move_black(const chess_board &board, const chess_history *pHistory = nullptr, const search_limits *pLimits = nullptr, _Out_opt_ search_result *pResult = nullptr);
+
+constexpr size_t MaxSkillLevel = 10;
+constexpr size_t SkillLevelMinNodes = 1000; // doubles with every skill level.
+
+// Node budgets instead of time limits make the strength independent of the machine. The moves still depend on what earlier searches left in the transposition table and the caches of the search threads, unless both are cleared with `transposition_table_clear` and `search_caches_clear` before each move.
+search_limits get_skill_level_limits(const size_t skillLevel);
+
+// Parallel searches share a thread pool, which can be destroyed (along with the caches of the search threads) once no more searches are going to happen.
+void search_thread_pool_destroy();
+
+// The search threads keep their move ordering statistics, pawn hash tables and evaluation caches across searches. Clearing them (and the transposition table) makes the next search run like the first one.
+void search_caches_clear();
+
+// Searches a fixed set of positions with `limits`, which must neither involve time nor multiple threads, and prints the results. The total node count is the same for every run of the same build.
+lsResult run_search_bench(const search_limits &limits, _Out_opt_ size_t *pTotalNodes = nullptr);
+
+// Runs the bench to `depth` with 1, 2, 4, 8, 16 and 32 threads in `mode` and prints the time to depth and the node counts of each, next to the ones of Lazy SMP for other modes.
+lsResult run_parallel_search_bench(const size_t depth, const search_parallel_mode mode);
 
 void print_board(const chess_board &board);
 void print_move(const chess_move move);
@@ -29,6 +29,10 @@ lsResult lsWriteFile(const char *filename, const T *pData, const size_t count)
   return lsWriteFileBytes(filename, reinterpret_cast<const uint8_t *>(pData), count * sizeof(T));
 }
 
+// Maps the file as a private copy-on-write view: pages are only read from disk once they're touched and writes never reach the file.
+lsResult lsMapFileBytes(const char *filename, _Out_ uint8_t **ppData, _Out_ size_t *pSize);
+void lsUnmapFileBytes(_In_Out_ uint8_t **ppData, const size_t size);
+
 bool lsFileExists(const char *filename);
 
 lsResult lsCreateDirectory(const wchar_t *directory);
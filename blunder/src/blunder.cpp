@@ -2,8 +2,10 @@
 #include "testable.h"
 #include "local_list.h"
 #include "io.h"
+#include "thread_pool.h"
 
 #include <conio.h>
+#include <mutex>
 
 constexpr vec2i8 TopLeftRelative = vec2i8(-1, -1);
 constexpr vec2i8 TopRelative = vec2i8(0, -1);
@@ -18,19 +20,12 @@ inline bool is_check_straight(const chess_board &board, const vec2i8 pos, const
 {
   lsAssert(pos.x >= 0 && pos.x < BoardWidth && pos.y >= 0 && pos.y < BoardWidth);
 
-  for (vec2i8 t = pos; t.x >= 0 && t.x < BoardWidth && t.y >= 0 && t.y < BoardWidth; t += dir)
+  for (vec2i8 t = pos + dir; t.x >= 0 && t.x < BoardWidth && t.y >= 0 && t.y < BoardWidth; t += dir)
   {
     const chess_piece p = board[t];
 
     if (p.piece)
-    {
-      if (p.isWhite == isWhite)
-        break;
-
-      if (p.isWhite != isWhite)
-        if (p.piece == cpT_rook || p.piece == cpT_queen)
-          return true;
-    }
+      return p.isWhite != isWhite && (p.piece == cpT_rook || p.piece == cpT_queen); // any piece blocks the line.
   }
 
   return false;
@@ -40,19 +35,12 @@ inline bool is_check_diagonal(const chess_board &board, const vec2i8 pos, const
 {
   lsAssert(pos.x >= 0 && pos.x < BoardWidth && pos.y >= 0 && pos.y < BoardWidth);
 
-  for (vec2i8 t = pos; t.x >= 0 && t.x < BoardWidth && t.y >= 0 && t.y < BoardWidth; t += dir)
+  for (vec2i8 t = pos + dir; t.x >= 0 && t.x < BoardWidth && t.y >= 0 && t.y < BoardWidth; t += dir)
   {
     const chess_piece p = board[t];
 
     if (p.piece)
-    {
-      if (p.isWhite == isWhite)
-        break;
-
-      if (p.isWhite != isWhite)
-        if (p.piece == cpT_bishop || p.piece == cpT_queen)
-          return true;
-    }
+      return p.isWhite != isWhite && (p.piece == cpT_bishop || p.piece == cpT_queen); // any piece blocks the line.
   }
 
   return false;
@@ -62,22 +50,37 @@ bool is_check_for_position(const chess_board &board, const vec2i8 pos, const boo
 {
   lsAssert(pos.x >= 0 && pos.x < BoardWidth && pos.y >= 0 && pos.y < BoardWidth);
 
-  if (is_check_straight(board, pos, isWhite, vec2i8(0, 1)) || is_check_straight(board, pos, isWhite, vec2i8(0, -1)) || is_check_straight(board, pos, isWhite, vec2i8(1, 0)) || is_check_straight(board, pos, isWhite, vec2i8(-1, 0)) || is_check_diagonal(board, pos, isWhite, vec2i8(1, 1)) || is_check_diagonal(board, pos, isWhite, vec2i8(-1, -1)))
+  if (is_check_straight(board, pos, isWhite, vec2i8(0, 1)) || is_check_straight(board, pos, isWhite, vec2i8(0, -1)) || is_check_straight(board, pos, isWhite, vec2i8(1, 0)) || is_check_straight(board, pos, isWhite, vec2i8(-1, 0)))
+    return true;
+
+  if (is_check_diagonal(board, pos, isWhite, vec2i8(1, 1)) || is_check_diagonal(board, pos, isWhite, vec2i8(-1, -1)) || is_check_diagonal(board, pos, isWhite, vec2i8(1, -1)) || is_check_diagonal(board, pos, isWhite, vec2i8(-1, 1)))
     return true;
 
   // pawns
-  const vec2i8 pawnPosLeft = isWhite ? pos + vec2i8(-1, 1) : vec2i8(-1, -1);
-  const vec2i8 pawnPosRight = isWhite ? pos + vec2i8(1, 1) : vec2i8(1, -1);
+  const vec2i8 pawnPosLeft = pos + (isWhite ? vec2i8(-1, 1) : vec2i8(-1, -1));
+  const vec2i8 pawnPosRight = pos + (isWhite ? vec2i8(1, 1) : vec2i8(1, -1));
 
   if (pawnPosLeft.y >= 0 && pawnPosLeft.y < BoardWidth) // y is the same for left and right
   {
     if (pawnPosLeft.x >= 0 && board[pawnPosLeft].piece == cpT_pawn && board[pawnPosLeft].isWhite != isWhite)
       return true;
 
-    if (pawnPosRight.x < BoardWidth && board[pawnPosLeft].piece == cpT_pawn && board[pawnPosLeft].isWhite != isWhite)
+    if (pawnPosRight.x < BoardWidth && board[pawnPosRight].piece == cpT_pawn && board[pawnPosRight].isWhite != isWhite)
       return true;
   }
 
+  // kings
+  for (int32_t y = lsMax(0, pos.y - 1); y <= lsMin((int32_t)BoardWidth - 1, pos.y + 1); y++)
+  {
+    for (int32_t x = lsMax(0, pos.x - 1); x <= lsMin((int32_t)BoardWidth - 1, pos.x + 1); x++)
+    {
+      const chess_piece p = board[vec2i8((int8_t)x, (int8_t)y)];
+
+      if (p.piece == cpT_king && p.isWhite != isWhite)
+        return true;
+    }
+  }
+
   // knights
   constexpr static vec2i8 TargetDir[] = { vec2i8(-2, -1), vec2i8(-1, -2), vec2i8(1, -2), vec2i8(2, -1), vec2i8(2, 1), vec2i8(1, 2), vec2i8(-1, 2), vec2i8(-2, 1) };
 
@@ -97,6 +100,15 @@ bool is_check_for_position(const chess_board &board, const vec2i8 pos, const boo
   return false;
 }
 
+bool is_in_check(const chess_board &board)
+{
+  for (size_t i = 0; i < LS_ARRAYSIZE(board.board); i++)
+    if (board.board[i].piece == cpT_king && board.board[i].isWhite == board.isWhitesTurn)
+      return is_check_for_position(board, vec2i8((int8_t)(i % BoardWidth), (int8_t)(i / BoardWidth)), board.isWhitesTurn);
+
+  return false;
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 template <typename T>
@@ -551,6 +563,86 @@ epilogue:
 
 //////////////////////////////////////////////////////////////////////////
 
+constexpr uint64_t zobrist_next_key(uint64_t &state) // splitmix64, so the keys (and with them all persisted hashes) are the same for every build.
+{
+  uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+struct zobrist_keys
+{
+  uint64_t pieces[_chess_piece_type_count][2][BoardWidth * BoardWidth] = {}; // [piece][isWhite][position], `cpT_none` is all zeroes.
+  uint64_t unmoved[BoardWidth * BoardWidth] = {}; // for kings and rooks that haven't moved yet, which is all castling needs to know.
+  uint64_t enPassant[BoardWidth] = {}; // [file of the pawn that just double stepped]
+  uint64_t whitesTurn = 0;
+
+  constexpr zobrist_keys()
+  {
+    uint64_t state = 0x12CA7F00D511;
+
+    for (size_t piece = cpT_none + 1; piece < _chess_piece_type_count; piece++)
+      for (size_t color = 0; color < 2; color++)
+        for (size_t i = 0; i < BoardWidth * BoardWidth; i++)
+          pieces[piece][color][i] = zobrist_next_key(state);
+
+    for (size_t i = 0; i < BoardWidth * BoardWidth; i++)
+      unmoved[i] = zobrist_next_key(state);
+
+    for (size_t i = 0; i < BoardWidth; i++)
+      enPassant[i] = zobrist_next_key(state);
+
+    whitesTurn = zobrist_next_key(state);
+  }
+};
+
+static constexpr zobrist_keys ZobristKeys;
+
+inline uint64_t zobrist_key(const chess_piece piece, const size_t index)
+{
+  return ZobristKeys.pieces[piece.piece][piece.isWhite][index];
+}
+
+inline uint64_t zobrist_castling_key(const chess_piece piece, const size_t index)
+{
+  if ((piece.piece == cpT_king || piece.piece == cpT_rook) && !piece.hasMoved)
+    return ZobristKeys.unmoved[index];
+
+  return 0;
+}
+
+uint64_t chess_board_get_hash(const chess_board &board)
+{
+  uint64_t ret = 0;
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(board.board); i++)
+  {
+    ret ^= zobrist_key(board.board[i], i) ^ zobrist_castling_key(board.board[i], i);
+
+    if (board.board[i].lastWasDoubleStep && board.board[i].piece == cpT_pawn) // moving a piece away leaves the flag behind on the empty square.
+      ret ^= ZobristKeys.enPassant[i % BoardWidth];
+  }
+
+  if (board.isWhitesTurn)
+    ret ^= ZobristKeys.whitesTurn;
+
+  return ret;
+}
+
+uint64_t chess_board_get_pawn_hash(const chess_board &board)
+{
+  uint64_t ret = 0;
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(board.board); i++)
+    if (board.board[i].piece == cpT_pawn)
+      ret ^= zobrist_key(board.board[i], i);
+
+  return ret;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 __forceinline void assert_move_type(const chess_move move, const chess_move_type type, [[maybe_unused]] const chess_board &board)
 {
 #ifdef _DEBUG
@@ -566,14 +658,42 @@ chess_board perform_move(const chess_board &board, const chess_move move)
 {
   chess_board ret = board;
   ret.isWhitesTurn = (uint8_t)!board.isWhitesTurn;
+  ret.hash ^= ZobristKeys.whitesTurn;
 
   for (size_t i = 0; i < LS_ARRAYSIZE(ret.board); i++)
+  {
+    if (ret.board[i].lastWasDoubleStep && ret.board[i].piece == cpT_pawn)
+      ret.hash ^= ZobristKeys.enPassant[i % BoardWidth];
+
     ret.board[i].lastWasDoubleStep = false;
+  }
 
   chess_piece &origin = ret[vec2i8(move.startX, move.startY)];
   chess_piece &target = ret[vec2i8(move.targetX, move.targetY)];
   lsAssert(origin.isWhite == board.isWhitesTurn);
 
+  const size_t originIndex = move.startY * BoardWidth + move.startX;
+  const size_t targetIndex = move.targetY * BoardWidth + move.targetX;
+
+  ret.hash ^= zobrist_key(origin, originIndex) ^ zobrist_castling_key(origin, originIndex); // the moved piece is added back at the end, as it may get promoted.
+  ret.hash ^= zobrist_key(target, targetIndex) ^ zobrist_castling_key(target, targetIndex);
+
+  if (origin.piece == cpT_pawn || target.piece != cpT_none)
+    ret.halfMoveClock = 0;
+  else if (ret.halfMoveClock < lsMaxValue<uint8_t>())
+    ret.halfMoveClock++;
+
+  if (origin.piece == cpT_pawn)
+  {
+    ret.pawnHash ^= zobrist_key(origin, originIndex);
+
+    if (!move.isPromotion)
+      ret.pawnHash ^= zobrist_key(origin, targetIndex);
+  }
+
+  if (target.piece == cpT_pawn)
+    ret.pawnHash ^= zobrist_key(target, targetIndex);
+
   if (target.piece == cpT_king)
   {
     size_t kingCount = 0;
@@ -596,6 +716,7 @@ chess_board perform_move(const chess_board &board, const chess_move move)
     {
       assert_move_type(move, cmt_pawn_double_step, board);
       origin.lastWasDoubleStep = true;
+      ret.hash ^= ZobristKeys.enPassant[move.startX];
     }
     else if (move.isPromotion)
     {
@@ -619,6 +740,8 @@ chess_board perform_move(const chess_board &board, const chess_move move)
         assert_move_type(move, cmt_pawn_en_passant, board);
         const vec2i8 enemyPos = vec2i8(move.targetX, move.startY);
         lsAssert(board[enemyPos].piece && board[enemyPos].lastWasDoubleStep && board[enemyPos].piece == cpT_pawn && (board[enemyPos].isWhite == ret.isWhitesTurn));
+        ret.hash ^= zobrist_key(ret[enemyPos], enemyPos.y * BoardWidth + enemyPos.x);
+        ret.pawnHash ^= zobrist_key(ret[enemyPos], enemyPos.y * BoardWidth + enemyPos.x);
         ret[enemyPos].piece = cpT_none;
       }
     }
@@ -642,6 +765,9 @@ chess_board perform_move(const chess_board &board, const chess_move move)
       chess_piece &rookOrigin = ret[rookPosOrigin];
       chess_piece &rookTarget = ret[rookPosTarget];
 
+      ret.hash ^= zobrist_key(rookOrigin, rookPosOrigin.y * BoardWidth + rookPosOrigin.x) ^ zobrist_castling_key(rookOrigin, rookPosOrigin.y * BoardWidth + rookPosOrigin.x);
+      ret.hash ^= zobrist_key(rookOrigin, rookPosTarget.y * BoardWidth + rookPosTarget.x);
+
       rookOrigin.hasMoved = true;
       rookTarget = std::move(rookOrigin);
       ret[rookPosOrigin].piece = cpT_none;
@@ -673,10 +799,74 @@ chess_board perform_move(const chess_board &board, const chess_move move)
 
   origin.hasMoved = true;
   target = std::move(origin);
+  ret.hash ^= zobrist_key(target, targetIndex);
+
+  lsAssert(ret.hash == chess_board_get_hash(ret));
+  lsAssert(ret.pawnHash == chess_board_get_pawn_hash(ret));
 
   return ret;
 }
 
+// Passes the turn to the other side. Only used by the search.
+chess_board perform_null_move(const chess_board &board)
+{
+  chess_board ret = board;
+  ret.isWhitesTurn = (uint8_t)!board.isWhitesTurn;
+  ret.hash ^= ZobristKeys.whitesTurn;
+  ret.halfMoveClock = 0; // positions before the null move mustn't count as repetitions.
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(ret.board); i++)
+  {
+    if (ret.board[i].lastWasDoubleStep && ret.board[i].piece == cpT_pawn)
+      ret.hash ^= ZobristKeys.enPassant[i % BoardWidth];
+
+    ret.board[i].lastWasDoubleStep = false;
+  }
+
+  lsAssert(ret.hash == chess_board_get_hash(ret));
+
+  return ret;
+}
+
+bool has_non_pawn_material(const chess_board &board, const bool isWhite)
+{
+  for (size_t i = 0; i < LS_ARRAYSIZE(board.board); i++)
+    if (board.board[i].isWhite == isWhite && board.board[i].piece != cpT_none && board.board[i].piece != cpT_pawn && board.board[i].piece != cpT_king)
+      return true;
+
+  return false;
+}
+
+// Quiet moves neither capture (including en passant) nor promote.
+bool is_quiet_move(const chess_board &board, const chess_move move)
+{
+  if (move.isPromotion || board[vec2i8(move.targetX, move.targetY)].piece != cpT_none)
+    return false;
+
+  return !(board[vec2i8(move.startX, move.startY)].piece == cpT_pawn && move.startX != move.targetX);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+lsResult chess_history_add(chess_history &history, const chess_board &board)
+{
+  lsResult result = lsR_Success;
+
+  // positions before the last irreversible move can't come up again.
+  if (board.halfMoveClock == 0)
+    list_clear(&history.hashes);
+
+  LS_ERROR_CHECK(list_add(&history.hashes, board.hash));
+
+epilogue:
+  return result;
+}
+
+void chess_history_clear(chess_history &history)
+{
+  list_clear(&history.hashes);
+}
+
 //////////////////////////////////////////////////////////////////////////
 
 bool is_upper_case(const char c)
@@ -769,6 +959,9 @@ chess_board get_board_from_starting_position(const char *startingPosition)
     if (ret.board[j].piece != startBoard.board[j].piece)
       ret.board[j].hasMoved = true;
 
+  ret.hash = chess_board_get_hash(ret);
+  ret.pawnHash = chess_board_get_pawn_hash(ret);
+
   return ret;
 }
 
@@ -887,6 +1080,9 @@ on_board_parsed:
     if (ret.board[j].piece != startBoard.board[j].piece)
       ret.board[j].hasMoved = true;
 
+  ret.hash = chess_board_get_hash(ret);
+  ret.pawnHash = chess_board_get_pawn_hash(ret);
+
   *pFenString = fenString + i;
 
   return ret;
@@ -986,6 +1182,9 @@ chess_board chess_board::get_starting_point()
     place_symmetric_last_row(board, lastRow[i], i);
   }
 
+  board.hash = chess_board_get_hash(board);
+  board.pawnHash = chess_board_get_pawn_hash(board);
+
   return board;
 }
 
@@ -1013,7 +1212,8 @@ uint64_t lsHash(const chess_hash_board &board)
   __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(board.nibbleMap));
   __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(board.nibbleMap) + 1);
   v0 = _mm_aesdec_si128(v0, v1);
-  uint64_t ret = _mm_extract_epi64(v0, 0);
+  v0 = _mm_aesdec_si128(v0, v1); // a single round only mixes half of the bytes into each 64 bit lane.
+  uint64_t ret = _mm_extract_epi64(v0, 0) ^ _mm_extract_epi64(v0, 1);
   ret ^= board.isWhitesTurn;
   return ret;
 }
@@ -1278,7 +1478,7 @@ static_assert(LS_ARRAYSIZE(SquareWeights) == _chess_piece_type_count);
 
 constexpr int64_t PieceScores[] = { 0, 100000, 950, 563, 333, 305, 100 }; // Chess piece values from `https://en.wikipedia.org/wiki/Chess_piece_relative_value#Alternative_valuations > AlphaZero`.
 
-int64_t evaluate_chess_board(const chess_board &board)
+inline int64_t evaluate_piece_squares(const chess_board &board)
 {
   int64_t ret = 0;
 
@@ -1308,424 +1508,2235 @@ int64_t evaluate_chess_board(const chess_board &board)
 
 //////////////////////////////////////////////////////////////////////////
 
-struct move_with_score
-{
-  chess_move move;
-  int64_t score;
-
-  move_with_score() = default;
-  move_with_score(const chess_move move, const int64_t score) : move(move), score(score) {}
-};
+// Bitboards index squares like `chess_board::board`: bit `y * BoardWidth + x`.
+constexpr uint64_t BitboardFileA = 0x0101010101010101ULL;
 
-template <size_t DepthRemaining, bool FindMin>
-move_with_score minimax_step(const chess_board &board)
+struct pawn_structure_masks
 {
-  if constexpr (DepthRemaining == 0)
-  {
-    return move_with_score({}, evaluate_chess_board(board));
-  }
-  else
-  {
-    list<chess_move> moves;
-    list_clear(&moves);
-    LS_DEBUG_ERROR_ASSERT(get_all_valid_moves(board, moves));
-    move_with_score ret;
-    ret.move = {};
-    ret.score = FindMin ? lsMaxValue<int64_t>() : lsMinValue<int64_t>();
+  uint64_t adjacentFiles[BoardWidth] = {};
+  uint64_t passedSpan[2][BoardWidth * BoardWidth] = {}; // [isWhite][position]: squares on the same and adjacent files in front of the pawn.
+  uint64_t supportSpan[2][BoardWidth * BoardWidth] = {}; // [isWhite][position]: squares on the adjacent files level with or behind the pawn.
+  uint64_t attacks[2][BoardWidth * BoardWidth] = {}; // [isWhite][position]
 
-    for (const chess_move move : moves)
+  constexpr pawn_structure_masks()
+  {
+    for (int8_t x = 0; x < BoardWidth; x++)
     {
-      const chess_board after = perform_move(board, move);
-      const move_with_score move_rating = minimax_step<DepthRemaining - 1, !FindMin>(after);
+      if (x > 0)
+        adjacentFiles[x] |= BitboardFileA << (x - 1);
 
-      if constexpr (FindMin)
-      {
-        if (move_rating.score < ret.score)
-          ret = move_with_score(move, move_rating.score);
-      }
-      else
+      if (x < BoardWidth - 1)
+        adjacentFiles[x] |= BitboardFileA << (x + 1);
+    }
+
+    for (int8_t y = 0; y < BoardWidth; y++)
+    {
+      for (int8_t x = 0; x < BoardWidth; x++)
       {
-        if (move_rating.score > ret.score)
-          ret = move_with_score(move, move_rating.score);
+        const size_t i = y * BoardWidth + x;
+        const uint64_t files = adjacentFiles[x] | (BitboardFileA << x);
+
+        for (int8_t ry = 0; ry < BoardWidth; ry++)
+        {
+          const uint64_t rank = 0xFFULL << (ry * BoardWidth);
+
+          if (ry > y)
+          {
+            passedSpan[true][i] |= files & rank;
+            supportSpan[false][i] |= adjacentFiles[x] & rank;
+          }
+          else if (ry < y)
+          {
+            passedSpan[false][i] |= files & rank;
+            supportSpan[true][i] |= adjacentFiles[x] & rank;
+          }
+          else
+          {
+            supportSpan[true][i] |= adjacentFiles[x] & rank;
+            supportSpan[false][i] |= adjacentFiles[x] & rank;
+          }
+        }
+
+        for (int8_t dx = -1; dx <= 1; dx += 2)
+        {
+          if (x + dx < 0 || x + dx >= BoardWidth)
+            continue;
+
+          if (y + 1 < BoardWidth)
+            attacks[true][i] |= 1ULL << ((y + 1) * BoardWidth + x + dx);
+
+          if (y > 0)
+            attacks[false][i] |= 1ULL << ((y - 1) * BoardWidth + x + dx);
+        }
       }
     }
-
-    return ret;
   }
-}
+};
 
-//////////////////////////////////////////////////////////////////////////
+static constexpr pawn_structure_masks PawnStructureMasks;
+
+constexpr int64_t DoubledPawnPenalty = 15;
+constexpr int64_t IsolatedPawnPenalty = 15;
+constexpr int64_t BackwardPawnPenalty = 10;
+constexpr int64_t PassedPawnBonus[BoardWidth] = { 0, 10, 15, 25, 40, 65, 100, 0 }; // by rank, as seen from the side of the pawn.
 
-struct score_with_depth
+inline size_t bitboard_count(uint64_t bitboard)
 {
-  int64_t score;
-  size_t depth;
+  size_t ret = 0;
 
-  bool operator<(const score_with_depth other) const
-  {
-    if (score == other.score)
-      return depth < other.depth;
-    else
-      return score < other.score;
-  }
+  for (; bitboard; bitboard &= bitboard - 1)
+    ret++;
 
-  bool operator<=(const score_with_depth other) const
-  {
-    if (score == other.score)
-      return depth <= other.depth;
-    else
-      return score <= other.score;
-  }
+  return ret;
+}
+
+template <bool IsWhite>
+int64_t evaluate_pawn_structure_for(const uint64_t ownPawns, const uint64_t enemyPawns)
+{
+  int64_t ret = 0;
 
-  bool operator>(const score_with_depth other) const
+  for (int8_t x = 0; x < BoardWidth; x++)
   {
-    if (score == other.score)
-      return depth < other.depth;
-    else
-      return score > other.score;
+    const size_t pawnsOnFile = bitboard_count(ownPawns & (BitboardFileA << x));
+
+    if (pawnsOnFile > 1)
+      ret -= DoubledPawnPenalty * (int64_t)(pawnsOnFile - 1);
   }
 
-  bool operator>=(const score_with_depth other) const
+  for (uint64_t remaining = ownPawns; remaining; remaining &= remaining - 1)
   {
-    if (score == other.score)
-      return depth <= other.depth;
-    else
-      return score >= other.score;
-  }
-};
+    const size_t i = (size_t)lsLowestBit(remaining);
+    const int8_t x = (int8_t)(i % BoardWidth);
+    const int8_t y = (int8_t)(i / BoardWidth);
 
+    if (!(enemyPawns & PawnStructureMasks.passedSpan[IsWhite][i]))
+      ret += PassedPawnBonus[IsWhite ? y : (BoardWidth - 1 - y)];
 
-template <size_t MaxDepth>
-struct moves_with_score
-{
-  chess_move moves[MaxDepth];
-  score_with_depth score;
+    if (!(ownPawns & PawnStructureMasks.adjacentFiles[x]))
+    {
+      ret -= IsolatedPawnPenalty;
+    }
+    else if (!(ownPawns & PawnStructureMasks.supportSpan[IsWhite][i]))
+    {
+      // no pawn can ever defend this one, so it's backward if it can't even advance without being captured.
+      const size_t stopIndex = IsWhite ? i + BoardWidth : i - BoardWidth;
 
-  moves_with_score() = default;
-  moves_with_score(const chess_move moves[MaxDepth], const score_with_depth score) : score(score)
-  {
-    lsMemcpy(this->moves, moves, LS_ARRAYSIZE(this->moves));
+      if (stopIndex < BoardWidth * BoardWidth && (enemyPawns & PawnStructureMasks.attacks[IsWhite][stopIndex]))
+        ret -= BackwardPawnPenalty;
+    }
   }
-};
-
-constexpr bool UseCache = false;
 
-constexpr size_t StartingBoardHashCount = 1024 * 16;
-micro_starting_board *pStartingBoardHashMap = nullptr;
-
-void starting_hash_boards_create()
-{
-  lsAllocZero(&pStartingBoardHashMap, StartingBoardHashCount);
-  parse_fen_book("C:/data/common_openings.txt", pStartingBoardHashMap, StartingBoardHashCount);
+  return ret;
 }
 
-template <size_t MaxDepth>
-struct alpha_beta_minimax_cache
+int64_t evaluate_pawn_structure(const chess_board &board)
 {
-  static constexpr size_t MaxQuiescenceDepth = 20;
+  uint64_t pawns[2] = {}; // [isWhite]
 
-  list<chess_move> movesAtLevel[MaxDepth];
-  chess_move currentMove[MaxDepth + MaxQuiescenceDepth];
-#ifdef _DEBUG
-  size_t nodesVisited = 0;
-  size_t quiescenceNodesVisited = 0;
-  size_t duplicatesRejected = 0;
-  chess_move highestMove[MaxDepth];
-  chess_move lowestMove[MaxDepth];
-  score_with_depth lowestScore = score_with_depth(lsMaxValue<int64_t>(), MaxDepth + MaxQuiescenceDepth);
-  score_with_depth highestScore = score_with_depth(lsMinValue<int64_t>(), MaxDepth + MaxQuiescenceDepth);
+  for (size_t i = 0; i < LS_ARRAYSIZE(board.board); i++)
+    if (board.board[i].piece == cpT_pawn)
+      pawns[board.board[i].isWhite] |= 1ULL << i;
 
-  score_with_depth stepMin[MaxDepth];
-  score_with_depth stepMax[MaxDepth];
-#endif
+  return evaluate_pawn_structure_for<true>(pawns[true], pawns[false]) - evaluate_pawn_structure_for<false>(pawns[false], pawns[true]);
+}
 
-  constexpr static size_t hashBits = 20;
+// Only the upper half of `chess_board::pawnHash` is kept, the lower bits are implied by the index.
+struct pawn_hash_entry
+{
+  uint32_t pawnHashUpper;
+  int32_t score;
+};
+
+// Pawn structures rarely change during the search, so nearly all evaluations can be answered from here.
+struct pawn_hash_table
+{
+  constexpr static size_t hashBits = 15; // 256 KiB.
   constexpr static size_t hashValues = (1ULL << hashBits);
   constexpr static size_t hashMask = hashValues - 1;
 
-  chess_hash_board *pCache = nullptr;
-
-  piece_move_map<true> pieceMovesWithNonCapture;
-  piece_move_map<false> pieceMoves[2];
-  list<chess_move> quiescenceMovesAtLevel[MaxQuiescenceDepth];
-
-  int64_t ticksPerLayer[MaxDepth + 1] = {};
+  pawn_hash_entry *pEntries = nullptr;
 
-  alpha_beta_minimax_cache()
-  {
 #ifdef _DEBUG
-    for (size_t i = 0; i < MaxDepth; i++)
-    {
-      stepMin[i] = score_with_depth(lsMaxValue<int64_t>(), MaxDepth + MaxQuiescenceDepth);
-      stepMax[i] = score_with_depth(lsMinValue<int64_t>(), MaxDepth + MaxQuiescenceDepth);
-    }
+  size_t hits = 0;
+  size_t misses = 0;
 #endif
-  }
 
-  ~alpha_beta_minimax_cache()
+  ~pawn_hash_table()
   {
-    lsFreePtr(&pCache);
+    lsFreePtr(&pEntries);
   }
 };
 
-constexpr float_t CacheSizeMB = (alpha_beta_minimax_cache<1>::hashValues * sizeof(chess_hash_board)) / (1024.0 * 1024.0);
+lsResult pawn_hash_table_create(pawn_hash_table &table)
+{
+  // zeroed entries are valid: the board without pawns has a `pawnHash` of 0 and a pawn structure score of 0.
+  return lsAllocZero(&table.pEntries, table.hashValues);
+}
 
-template <size_t MaxDepth>
-lsResult alpha_beta_minimax_cache_create(alpha_beta_minimax_cache<MaxDepth> &cache)
+void pawn_hash_table_clear(pawn_hash_table &table)
 {
-  return lsAllocZero(&cache.pCache, cache.hashValues);
+  lsZeroMemory(table.pEntries, table.hashValues);
 }
 
-template <size_t MaxDepth>
-bool alpha_beta_minimax_cache_find(const alpha_beta_minimax_cache<MaxDepth> &cache, const chess_hash_board &board, uint64_t &outHash, move_with_score &outRet)
+inline int64_t pawn_hash_table_evaluate(pawn_hash_table &table, const chess_board &board)
 {
-  const uint64_t hash = lsHash(board) & cache.hashMask;
-  const chess_hash_board found = cache.pCache[hash];
+  pawn_hash_entry &entry = table.pEntries[board.pawnHash & table.hashMask];
+  const uint32_t pawnHashUpper = (uint32_t)(board.pawnHash >> 32);
+
+  if (entry.pawnHashUpper == pawnHashUpper)
+  {
+#ifdef _DEBUG
+    table.hits++;
+#endif
+    return entry.score;
+  }
+
+#ifdef _DEBUG
+  table.misses++;
+#endif
+
+  entry.pawnHashUpper = pawnHashUpper;
+  entry.score = (int32_t)evaluate_pawn_structure(board);
 
-  outHash = hash;
-  outRet = move_with_score(found.move, found.score);
+  return entry.score;
+}
 
-  return found == board;
+int64_t evaluate_chess_board(const chess_board &board)
+{
+  return evaluate_piece_squares(board) + evaluate_pawn_structure(board);
 }
 
-template <size_t MaxDepth>
-void alpha_beta_minimax_cache_store(alpha_beta_minimax_cache<MaxDepth> &cache, chess_hash_board &board, const uint64_t hash, const move_with_score ret)
+int64_t evaluate_chess_board(const chess_board &board, pawn_hash_table &pawnTable)
 {
-  board.score = (int32_t)ret.score; // Needs to be set to score_with_depth if used again
-  board.move = ret.move;
-  cache.pCache[hash] = std::move(board);
+  return evaluate_piece_squares(board) + pawn_hash_table_evaluate(pawnTable, board);
 }
 
 //////////////////////////////////////////////////////////////////////////
 
-template <bool FindMin, size_t CacheDepth, size_t MaxDepth = alpha_beta_minimax_cache<CacheDepth>::MaxQuiescenceDepth>
-score_with_depth quiescence_alpha_beta_step(const chess_board &board, score_with_depth alpha, score_with_depth beta, alpha_beta_minimax_cache<CacheDepth> &cache, const size_t depthIndex = 0)
+// Direct-mapped cache of full evaluations, mostly hit by quiescence leaves reached through transpositions.
+// Each entry packs the upper bits of `chess_board::hash` with the 16 bit score, the lower bits are implied by the index.
+struct evaluation_cache
 {
-  const size_t OverallDepthIndex = CacheDepth + depthIndex;
-
-  if (board.hasBlackWon)
-    return score_with_depth(-PieceScores[cpT_king] / 2, OverallDepthIndex); // We don't want to return the full checkmated score as there may be a better move that is not found by quiescence
-  else if (board.hasWhiteWon)
-    return score_with_depth(PieceScores[cpT_king] / 2, OverallDepthIndex); // We don't want to return the full checkmated score as there may be a better move that is not found by quiescence
-  else if (depthIndex == MaxDepth)
-    return score_with_depth(evaluate_chess_board(board), OverallDepthIndex);
-
-  list<chess_move> &moves = cache.quiescenceMovesAtLevel[depthIndex];
-  LS_DEBUG_ERROR_ASSERT(get_valid_quiescence_moves(moves, board, cache.pieceMoves[0], cache.pieceMoves[1]));
+  constexpr static size_t hashBits = 15; // 256 KiB, like the pawn hash table.
+  constexpr static size_t hashValues = (1ULL << hashBits);
+  constexpr static size_t hashMask = hashValues - 1;
+  constexpr static uint64_t scoreMask = 0xFFFF;
 
-  if (!moves.count)
-    return score_with_depth(evaluate_chess_board(board), OverallDepthIndex);
+  uint64_t *pEntries = nullptr;
 
-  score_with_depth score = FindMin ? score_with_depth(lsMaxValue<int64_t>(), CacheDepth + MaxDepth) : score_with_depth(lsMinValue<int64_t>(), CacheDepth + MaxDepth);
+  size_t hits = 0;
+  size_t misses = 0;
 
-  for (const chess_move move : moves)
+  ~evaluation_cache()
   {
+    lsFreePtr(&pEntries);
+  }
+};
+
+void evaluation_cache_clear(evaluation_cache &cache)
+{
+  // zeroed entries would be hits for the empty board, so fill them with a key that's practically never matched.
+  for (size_t i = 0; i < cache.hashValues; i++)
+    cache.pEntries[i] = ~cache.scoreMask;
+}
+
+lsResult evaluation_cache_create(evaluation_cache &cache)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_CHECK(lsAlloc(&cache.pEntries, cache.hashValues));
+  evaluation_cache_clear(cache);
+
+epilogue:
+  return result;
+}
+
+int64_t evaluate_chess_board(const chess_board &board, evaluation_cache &evalCache, pawn_hash_table &pawnTable)
+{
+  uint64_t &entry = evalCache.pEntries[board.hash & evalCache.hashMask];
+
+  if ((entry & ~evalCache.scoreMask) == (board.hash & ~evalCache.scoreMask))
+  {
+    evalCache.hits++;
+    return (int16_t)(entry & evalCache.scoreMask);
+  }
+
+  evalCache.misses++;
+
+  const int64_t score = evaluate_chess_board(board, pawnTable);
+
+  // scores outside of the 16 bit range are rare enough to just be evaluated again.
+  if (score >= lsMinValue<int16_t>() && score <= lsMaxValue<int16_t>())
+    entry = (board.hash & ~evalCache.scoreMask) | (uint16_t)(int16_t)score;
+
+  return score;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+struct move_with_score
+{
+  chess_move move;
+  int64_t score;
+
+  move_with_score() = default;
+  move_with_score(const chess_move move, const int64_t score) : move(move), score(score) {}
+};
+
+template <size_t DepthRemaining, bool FindMin>
+move_with_score minimax_step(const chess_board &board)
+{
+  if constexpr (DepthRemaining == 0)
+  {
+    return move_with_score({}, evaluate_chess_board(board));
+  }
+  else
+  {
+    list<chess_move> moves;
+    list_clear(&moves);
+    LS_DEBUG_ERROR_ASSERT(get_all_valid_moves(board, moves));
+    move_with_score ret;
+    ret.move = {};
+    ret.score = FindMin ? lsMaxValue<int64_t>() : lsMinValue<int64_t>();
+
+    for (const chess_move move : moves)
+    {
+      const chess_board after = perform_move(board, move);
+      const move_with_score move_rating = minimax_step<DepthRemaining - 1, !FindMin>(after);
+
+      if constexpr (FindMin)
+      {
+        if (move_rating.score < ret.score)
+          ret = move_with_score(move, move_rating.score);
+      }
+      else
+      {
+        if (move_rating.score > ret.score)
+          ret = move_with_score(move, move_rating.score);
+      }
+    }
+
+    return ret;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Scores are relative to the side to move and fit into 32 bits. Capturing the king at `ply` is scored as `MateScore - ply`, so quicker wins score higher and slower losses score higher than quick ones.
+constexpr int32_t MateScore = 1000000;
+constexpr int32_t MaxMatePly = 256;
+constexpr int32_t MinMateScore = MateScore - MaxMatePly; // scores at least this far from zero are mate scores.
+constexpr int32_t InfiniteScore = MateScore + 1;
+
+inline bool is_mate_score(const int32_t score)
+{
+  return lsAbs(score) >= MinMateScore;
+}
+
+
+constexpr size_t StartingBoardHashCount = 1024 * 16;
+micro_starting_board *pStartingBoardHashMap = nullptr;
+
+void starting_hash_boards_create()
+{
+  lsAllocZero(&pStartingBoardHashMap, StartingBoardHashCount);
+  parse_fen_book("C:/data/common_openings.txt", pStartingBoardHashMap, StartingBoardHashCount);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+enum transposition_table_bound : uint8_t
+{
+  ttb_none, // zeroed entries are empty.
+  ttb_exact,
+  ttb_lower, // the actual score is at least `score`.
+  ttb_upper, // the actual score is at most `score`.
+};
+
+// Entries are read and written by all search threads without any locking. The key is the hash of the position xor'd with the rest of the entry, so an entry torn by concurrent stores doesn't match any position.
+struct transposition_table_entry
+{
+  uint64_t key;
+  int32_t score : 30; // relative to the side to move.
+  uint32_t bound : 2;
+  chess_move move;
+  uint8_t depth; // remaining search depth below the node that stored this entry.
+};
+
+#ifndef _DEBUG
+static_assert(sizeof(transposition_table_entry) == 16);
+#endif
+
+// The snapshot file is the header directly followed by the entries, which is exactly how the table is laid out in memory, so a snapshot can be mapped and used in place.
+struct transposition_table_header
+{
+  uint64_t magic;
+  uint32_t version;
+  uint32_t entrySize;
+  uint64_t entryCount;
+  uint8_t _reserved[40];
+};
+
+static_assert(sizeof(transposition_table_header) == 64);
+
+constexpr uint64_t TranspositionTableMagic = 0x545452444E554C42ULL; // "BLUNDRTT"
+constexpr uint32_t TranspositionTableVersion = 5;
+
+struct transposition_table
+{
+  uint8_t *pData = nullptr; // header + entries.
+  size_t dataSize = 0;
+  bool isMapped = false;
+
+  transposition_table_header *pHeader = nullptr;
+  transposition_table_entry *pEntries = nullptr;
+  size_t entryMask = 0;
+
+  transposition_table_stats stats; // `hashfullPermille` is only filled in by `transposition_table_get_stats`.
+};
+
+static transposition_table _TranspositionTable;
+
+static void transposition_table_release(transposition_table &table)
+{
+  if (table.isMapped)
+    lsUnmapFileBytes(&table.pData, table.dataSize);
+  else
+    lsFreePtr(&table.pData);
+
+  table = transposition_table();
+}
+
+static void transposition_table_attach(transposition_table &table, uint8_t *pData, const size_t dataSize, const bool isMapped)
+{
+  table.pData = pData;
+  table.dataSize = dataSize;
+  table.isMapped = isMapped;
+  table.pHeader = reinterpret_cast<transposition_table_header *>(pData);
+  table.pEntries = reinterpret_cast<transposition_table_entry *>(pData + sizeof(transposition_table_header));
+  table.entryMask = table.pHeader->entryCount - 1;
+}
+
+lsResult transposition_table_create(const size_t entryCountBits)
+{
+  lsResult result = lsR_Success;
+
+  const size_t entryCount = 1ULL << entryCountBits;
+  const size_t dataSize = sizeof(transposition_table_header) + entryCount * sizeof(transposition_table_entry);
+  uint8_t *pData = nullptr;
+
+  LS_ERROR_IF(entryCountBits == 0 || entryCountBits >= 40, lsR_ArgumentOutOfBounds);
+  LS_ERROR_CHECK(lsAllocZero(&pData, dataSize));
+
+  transposition_table_release(_TranspositionTable);
+  transposition_table_attach(_TranspositionTable, pData, dataSize, false);
+
+  _TranspositionTable.pHeader->magic = TranspositionTableMagic;
+  _TranspositionTable.pHeader->version = TranspositionTableVersion;
+  _TranspositionTable.pHeader->entrySize = sizeof(transposition_table_entry);
+  _TranspositionTable.pHeader->entryCount = entryCount;
+  _TranspositionTable.entryMask = entryCount - 1;
+
+epilogue:
+  return result;
+}
+
+void transposition_table_destroy()
+{
+  transposition_table_release(_TranspositionTable);
+}
+
+void transposition_table_clear()
+{
+  if (_TranspositionTable.pEntries != nullptr)
+    lsZeroMemory(_TranspositionTable.pEntries, _TranspositionTable.pHeader->entryCount);
+}
+
+lsResult transposition_table_save(const char *filename)
+{
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(filename == nullptr, lsR_ArgumentNull);
+  LS_ERROR_IF(_TranspositionTable.pData == nullptr, lsR_ResourceStateInvalid);
+
+  // The file we'd be writing to may be the one that's currently mapped (and can't be replaced while mapped), so move the table into regular memory first.
+  if (_TranspositionTable.isMapped)
+  {
+    uint8_t *pData = nullptr;
+    const size_t dataSize = _TranspositionTable.dataSize;
+    const transposition_table_stats stats = _TranspositionTable.stats;
+
+    LS_ERROR_CHECK(lsAlloc(&pData, dataSize));
+    memcpy(pData, _TranspositionTable.pData, dataSize);
+
+    transposition_table_release(_TranspositionTable);
+    transposition_table_attach(_TranspositionTable, pData, dataSize, false);
+    _TranspositionTable.stats = stats;
+  }
+
+  LS_ERROR_CHECK(lsWriteFileBytes(filename, _TranspositionTable.pData, _TranspositionTable.dataSize));
+
+  print_log_line("Saved transposition table (", _TranspositionTable.pHeader->entryCount, " entries) to '", filename, "'.");
+
+epilogue:
+  return result;
+}
+
+lsResult transposition_table_load(const char *filename)
+{
+  lsResult result = lsR_Success;
+
+  uint8_t *pData = nullptr;
+  size_t dataSize = 0;
+  const transposition_table_header *pHeader = nullptr;
+
+  LS_ERROR_IF(filename == nullptr, lsR_ArgumentNull);
+
+  LS_ERROR_CHECK(lsMapFileBytes(filename, &pData, &dataSize));
+  LS_ERROR_IF(dataSize < sizeof(transposition_table_header), lsR_ResourceInvalid);
+
+  pHeader = reinterpret_cast<const transposition_table_header *>(pData);
+
+  LS_ERROR_IF(pHeader->magic != TranspositionTableMagic, lsR_ResourceInvalid);
+  LS_ERROR_IF(pHeader->version != TranspositionTableVersion || pHeader->entrySize != sizeof(transposition_table_entry), lsR_ResourceIncompatible);
+  LS_ERROR_IF(pHeader->entryCount == 0 || (pHeader->entryCount & (pHeader->entryCount - 1)) != 0, lsR_ResourceInvalid);
+  LS_ERROR_IF(dataSize != sizeof(transposition_table_header) + pHeader->entryCount * sizeof(transposition_table_entry), lsR_ResourceInvalid);
+
+  // The snapshot replaces the current table only if it has the size the current table was created with.
+  if (_TranspositionTable.pHeader != nullptr)
+    LS_ERROR_IF(pHeader->entryCount != _TranspositionTable.pHeader->entryCount, lsR_ResourceIncompatible);
+
+  transposition_table_release(_TranspositionTable);
+  transposition_table_attach(_TranspositionTable, pData, dataSize, true);
+  pData = nullptr;
+
+  print_log_line("Loaded transposition table (", _TranspositionTable.pHeader->entryCount, " entries) from '", filename, "'.");
+
+epilogue:
+  lsUnmapFileBytes(&pData, dataSize);
+
+  return result;
+}
+
+constexpr size_t TranspositionTableHashfullSampleCount = 1000;
+
+transposition_table_stats transposition_table_get_stats()
+{
+  transposition_table_stats ret = _TranspositionTable.stats;
+
+  if (_TranspositionTable.pEntries == nullptr)
+    return ret;
+
+  const size_t sampleCount = lsMin(TranspositionTableHashfullSampleCount, _TranspositionTable.entryMask + 1);
+  size_t occupied = 0;
+
+  for (size_t i = 0; i < sampleCount; i++)
+    occupied += (size_t)(_TranspositionTable.pEntries[i].bound != ttb_none);
+
+  ret.hashfullPermille = (occupied * 1000) / sampleCount;
+
+  return ret;
+}
+
+void transposition_table_reset_stats()
+{
+  _TranspositionTable.stats = transposition_table_stats();
+}
+
+// Searches count into stats of their own, as all threads incrementing the shared counters would race and contend for them, and add those to the table once they're done.
+void transposition_table_stats_add(transposition_table_stats &stats, const transposition_table_stats &other)
+{
+  stats.probes += other.probes;
+  stats.hits += other.hits;
+  stats.cutoffs += other.cutoffs;
+  stats.stores += other.stores;
+  stats.replacements += other.replacements;
+  stats.collisions += other.collisions;
+}
+
+// Prints the counters accumulated since `since` was retrieved, along with the current occupancy.
+static void transposition_table_print_stats(const transposition_table_stats &since)
+{
+  const transposition_table_stats now = transposition_table_get_stats();
+  const size_t probes = now.probes - since.probes;
+  const size_t hits = now.hits - since.hits;
+  const size_t collisions = now.collisions - since.collisions;
+
+  print("Transposition table: ", FU(Group)(probes), " probes, ", FU(Group)(hits), " hits (", FF(Max(5))((hits * 100.f) / lsMax((size_t)1, probes)), "%), ", FU(Group)(now.cutoffs - since.cutoffs), " cutoffs, ", FU(Group)(collisions), " collisions (", FF(Max(5))((collisions * 100.f) / lsMax((size_t)1, probes)), "%)\n");
+  print("                     ", FU(Group)(now.stores - since.stores), " stores, ", FU(Group)(now.replacements - since.replacements), " replacements, hashfull: ", now.hashfullPermille, " / 1000\n");
+}
+
+inline uint64_t transposition_table_entry_checksum(const transposition_table_entry &entry)
+{
+  uint64_t words[sizeof(transposition_table_entry) / sizeof(uint64_t)];
+  static_assert(sizeof(words) == sizeof(transposition_table_entry));
+  memcpy(words, &entry, sizeof(words));
+
+  uint64_t ret = 0;
+
+  for (size_t i = 1; i < LS_ARRAYSIZE(words); i++)
+    ret ^= words[i];
+
+  return ret;
+}
+
+inline uint64_t transposition_table_entry_hash(const transposition_table_entry &entry)
+{
+  return entry.key ^ transposition_table_entry_checksum(entry);
+}
+
+// Returns the slot of the position and copies its entry, as other threads may overwrite it at any time.
+inline transposition_table_entry *transposition_table_probe(transposition_table &table, transposition_table_stats &stats, const uint64_t hash, _Out_ transposition_table_entry *pEntry, _Out_ bool *pMatches)
+{
+  transposition_table_entry *pSlot = &table.pEntries[hash & table.entryMask];
+  memcpy(pEntry, pSlot, sizeof(transposition_table_entry));
+
+  const bool isOccupied = pEntry->bound != ttb_none;
+  *pMatches = isOccupied && transposition_table_entry_hash(*pEntry) == hash;
+
+  stats.probes++;
+  stats.hits += (size_t)*pMatches;
+  stats.collisions += (size_t)(isOccupied && !*pMatches);
+
+  return pSlot;
+}
+
+// Mate scores are stored relative to the node that stores them rather than the root, as the same position may be reached at different plies.
+inline int32_t transposition_table_score_to_entry(const int32_t score, const size_t ply)
+{
+  if (score >= MinMateScore)
+    return score + (int32_t)ply;
+  else if (score <= -MinMateScore)
+    return score - (int32_t)ply;
+  else
+    return score;
+}
+
+inline int32_t transposition_table_score_from_entry(const int32_t score, const size_t ply)
+{
+  if (score >= MinMateScore)
+    return score - (int32_t)ply;
+  else if (score <= -MinMateScore)
+    return score + (int32_t)ply;
+  else
+    return score;
+}
+
+inline void transposition_table_store(transposition_table_stats &stats, transposition_table_entry *pSlot, const uint64_t hash, const int32_t score, const transposition_table_bound bound, const chess_move move, const size_t depth, const size_t ply)
+{
+  transposition_table_entry entry;
+  memcpy(&entry, pSlot, sizeof(entry));
+
+  const bool isOccupied = entry.bound != ttb_none;
+  const bool isSamePosition = isOccupied && transposition_table_entry_hash(entry) == hash;
+
+  // Always take over slots of other positions, but keep results from deeper searches of the same position.
+  if (isSamePosition && entry.depth > depth)
+    return;
+
+  stats.stores++;
+  stats.replacements += (size_t)(isOccupied && !isSamePosition);
+
+  lsZeroMemory(&entry, 1);
+  entry.score = transposition_table_score_to_entry(score, ply);
+  entry.bound = bound;
+  entry.move = move;
+  entry.depth = (uint8_t)depth;
+  entry.key = hash ^ transposition_table_entry_checksum(entry);
+
+  memcpy(pSlot, &entry, sizeof(entry));
+}
+
+inline int32_t transposition_table_entry_score(const transposition_table_entry &entry, const size_t ply)
+{
+  return transposition_table_score_from_entry(entry.score, ply);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Finds the least valuable piece of the given color attacking `target`, ignoring the pieces in `removed` (a mask of board indices).
+// Sliding pieces are looked up through removed pieces, so the pieces behind the ones that already captured (x-rays) join the exchange.
+inline bool static_exchange_least_valuable_attacker(const chess_board &board, const vec2i8 target, const bool isWhite, const uint64_t removed, vec2i8 *pPosition, chess_piece_type *pPiece)
+{
+  const auto is_attacker = [&](const vec2i8 pos, const chess_piece_type piece) -> bool
+    {
+      if (pos.x < 0 || pos.x >= BoardWidth || pos.y < 0 || pos.y >= BoardWidth || (removed & (1ULL << (pos.y * BoardWidth + pos.x))))
+        return false;
+
+      const chess_piece p = board[pos];
+      return p.piece == piece && p.isWhite == isWhite;
+    };
+
+  // pawns attack diagonally towards the opponent, so they're found diagonally behind the target.
+  const int8_t pawnDir = isWhite ? -1 : 1;
+
+  for (const int8_t x : { (int8_t)-1, (int8_t)1 })
+  {
+    if (is_attacker(target + vec2i8(x, pawnDir), cpT_pawn))
+    {
+      *pPosition = target + vec2i8(x, pawnDir);
+      *pPiece = cpT_pawn;
+      return true;
+    }
+  }
+
+  constexpr static vec2i8 KnightDir[] = { vec2i8(-2, -1), vec2i8(-1, -2), vec2i8(1, -2), vec2i8(2, -1), vec2i8(2, 1), vec2i8(1, 2), vec2i8(-1, 2), vec2i8(-2, 1) };
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(KnightDir); i++)
+  {
+    if (is_attacker(target + KnightDir[i], cpT_knight))
+    {
+      *pPosition = target + KnightDir[i];
+      *pPiece = cpT_knight;
+      return true;
+    }
+  }
+
+  constexpr static vec2i8 DiagonalDir[] = { TopLeftRelative, TopRightRelative, BottomLeftRelative, BottomRightRelative };
+  constexpr static vec2i8 StraightDir[] = { TopRelative, LeftRelative, RightRelative, BottomRelative };
+
+  // the first piece that isn't removed along each line (if any).
+  vec2i8 diagonal[LS_ARRAYSIZE(DiagonalDir)];
+  vec2i8 straight[LS_ARRAYSIZE(StraightDir)];
+
+  const auto first_on_line = [&](const vec2i8 dir) -> vec2i8
+    {
+      for (vec2i8 t = target + dir; t.x >= 0 && t.x < BoardWidth && t.y >= 0 && t.y < BoardWidth; t += dir)
+        if (board[t].piece != cpT_none && !(removed & (1ULL << (t.y * BoardWidth + t.x))))
+          return t;
+
+      return vec2i8(-1, -1);
+    };
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(DiagonalDir); i++)
+    diagonal[i] = first_on_line(DiagonalDir[i]);
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(StraightDir); i++)
+    straight[i] = first_on_line(StraightDir[i]);
+
+  for (const chess_piece_type piece : { cpT_bishop, cpT_rook, cpT_queen })
+  {
+    if (piece != cpT_rook)
+    {
+      for (size_t i = 0; i < LS_ARRAYSIZE(diagonal); i++)
+      {
+        if (is_attacker(diagonal[i], piece))
+        {
+          *pPosition = diagonal[i];
+          *pPiece = piece;
+          return true;
+        }
+      }
+    }
+
+    if (piece != cpT_bishop)
+    {
+      for (size_t i = 0; i < LS_ARRAYSIZE(straight); i++)
+      {
+        if (is_attacker(straight[i], piece))
+        {
+          *pPosition = straight[i];
+          *pPiece = piece;
+          return true;
+        }
+      }
+    }
+  }
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(DiagonalDir); i++)
+  {
+    for (const vec2i8 dir : { DiagonalDir[i], StraightDir[i] })
+    {
+      if (is_attacker(target + dir, cpT_king))
+      {
+        *pPosition = target + dir;
+        *pPiece = cpT_king;
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+// Static exchange evaluation: the material the side to move gains (or loses, if negative) with `move`, if both sides keep recapturing on the target square with their least valuable piece as long as that pays off.
+int64_t static_exchange_evaluation(const chess_board &board, const chess_move move)
+{
+  const vec2i8 start = vec2i8(move.startX, move.startY);
+  const vec2i8 target = vec2i8(move.targetX, move.targetY);
+  const chess_piece_type movingPiece = board[start].piece;
+
+  int64_t gain[32];
+  size_t depth = 0;
+
+  gain[0] = PieceScores[board[target].piece];
+
+  if (movingPiece == cpT_pawn && board[target].piece == cpT_none && move.startX != move.targetX) // en passant.
+    gain[0] = PieceScores[cpT_pawn];
+
+  int64_t attackerScore = PieceScores[movingPiece];
+
+  if (move.isPromotion)
+  {
+    const int64_t promotedScore = PieceScores[move.isPromotedToQueen ? cpT_queen : cpT_knight];
+    gain[0] += promotedScore - PieceScores[cpT_pawn];
+    attackerScore = promotedScore;
+  }
+
+  uint64_t removed = 1ULL << (start.y * BoardWidth + start.x);
+  bool isWhite = !board.isWhitesTurn;
+
+  while (depth + 1 < LS_ARRAYSIZE(gain))
+  {
+    vec2i8 attackerPosition;
+    chess_piece_type attacker;
+
+    if (!static_exchange_least_valuable_attacker(board, target, isWhite, removed, &attackerPosition, &attacker))
+      break;
+
+    depth++;
+    gain[depth] = attackerScore - gain[depth - 1]; // the score of capturing, if the opponent doesn't recapture.
+    attackerScore = PieceScores[attacker];
+    removed |= 1ULL << (attackerPosition.y * BoardWidth + attackerPosition.x);
+    isWhite = !isWhite;
+  }
+
+  // either side may stop capturing whenever continuing would lose material.
+  while (depth > 0)
+  {
+    gain[depth - 1] = -lsMax(-gain[depth - 1], gain[depth]);
+    depth--;
+  }
+
+  return gain[0];
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+constexpr size_t MaxQuiescenceDepth = 20;
+constexpr size_t MaxSearchPly = MaxSearchDepth + MaxQuiescenceDepth;
+static_assert(MaxSearchPly <= MaxMatePly);
+
+struct search_stack_entry
+{
+  list<chess_move> moves; // the moves generated at this ply.
+  chess_move currentMove; // the move that's currently being searched from this ply.
+  chess_move bestMove;
+  chess_move killers[2] = { chess_move(), chess_move() }; // quiet moves that recently caused a cutoff at this ply, most recent first.
+  chess_piece_type movedPiece = cpT_none; // the piece moved by `currentMove`.
+  chess_move excludedMove; // skipped while `hasExcludedMove` is set, to find out if it's singular.
+  size_t extensions = 0; // plies the search was extended by on the way from the root to this ply.
+  bool isNullMove = false; // whether `currentMove` is actually a null move.
+  bool hasExcludedMove = false;
+};
+
+constexpr int32_t MaxHistoryScore = 1 << 14;
+
+// History of quiet moves in the context of the move one (or two) plies earlier: [previous piece - 1][previous target][piece - 1][target].
+// White and black share the table, which takes 288 KiB, as neither the side to move nor `cpT_none` are part of the index.
+struct continuation_history
+{
+  static constexpr size_t PieceTargetCount = (_chess_piece_type_count - 1) * BoardWidth * BoardWidth;
+  static constexpr size_t EntryCount = PieceTargetCount * PieceTargetCount;
+
+  int16_t *pEntries = nullptr;
+
+  ~continuation_history()
+  {
+    lsFreePtr(&pEntries);
+  }
+};
+
+lsResult continuation_history_create(continuation_history &history)
+{
+  return lsAllocZero(&history.pEntries, history.EntryCount);
+}
+
+struct root_split;
+
+struct alpha_beta_minimax_cache
+{
+  search_stack_entry stack[MaxSearchPly];
+#ifdef _DEBUG
+  size_t nodesVisited = 0;
+  size_t quiescenceNodesVisited = 0;
+  size_t duplicatesRejected = 0;
+  chess_move highestMove[MaxSearchDepth];
+  chess_move lowestMove[MaxSearchDepth];
+  size_t highestMoveCount = 0;
+  size_t lowestMoveCount = 0;
+  int32_t lowestScore = InfiniteScore; // white relative, like `highestScore`.
+  int32_t highestScore = -InfiniteScore;
+
+  int32_t stepMin[MaxSearchDepth];
+  int32_t stepMax[MaxSearchDepth];
+#endif
+
+  static constexpr size_t MaxHistoryLength = FiftyMoveRulePlies;
+
+  uint64_t hashHistory[MaxHistoryLength + MaxSearchDepth + 1]; // keys of the game history, followed by the keys along the current search path.
+  size_t hashHistoryRootIndex = 0;
+
+  transposition_table *pTranspositionTable = nullptr;
+  transposition_table_stats transpositionTableStats; // of this thread, added to the ones of the table after the search.
+  pawn_hash_table pawnHashTable;
+  evaluation_cache evaluationCache;
+
+  piece_move_map<true> pieceMovesWithNonCapture;
+  piece_move_map<false> pieceMoves[2];
+
+  int16_t history[2][BoardWidth * BoardWidth][BoardWidth * BoardWidth] = {}; // [isWhite][start][target] how often quiet moves caused cutoffs, within +/- `MaxHistoryScore`.
+  continuation_history continuationHistory[2]; // indexed by the move one and two plies back.
+  chess_move counterMoves[2][_chess_piece_type_count][BoardWidth * BoardWidth] = {}; // [isWhite][previous piece][previous target] the last quiet move that refuted the previous move.
+
+  int64_t ticksPerLayer[MaxSearchDepth + 1] = {};
+
+  // Triangular principal variation table: the best line found from `ply` on is `pv[ply][ply]` ~ `pv[ply][pvLength[ply] - 1]`.
+  chess_move pv[MaxSearchDepth + 1][MaxSearchDepth + 1];
+  size_t pvLength[MaxSearchDepth + 1] = {};
+
+  search_line rootLines[MaxMultiPv]; // the lines of the last completed iteration, as the table is overwritten by the next one.
+  size_t rootLineCount = 0;
+  size_t rootLinesDepth = 0;
+
+  chess_move rootExcludedMoves[MaxMultiPv]; // the root moves of the lines that have already been found in the running iteration.
+  size_t rootExcludedMoveCount = 0;
+
+  size_t aspirationFailHighs = 0;
+  size_t aspirationFailLows = 0;
+
+  size_t threadIndex = 0; // zero for the main thread, which is the only one that prints, helper threads of a parallel search count up from one.
+  root_split *pRootSplit = nullptr; // set on the main thread of a root split search, which distributes the root moves among the threads of the split.
+  bool deferSearchingPositions = false; // set on all threads of an ABDADA search.
+
+  size_t nullMoveMinPly = 0; // null moves are only tried from this ply on, which is raised while verifying a null move cutoff.
+  size_t rootDepth = 0; // the depth of the current iteration.
+
+  size_t nodes = 0; // main and quiescence search nodes, counted in every build.
+  size_t maxNodes = 0;
+  int64_t hardDeadlineNs = 0;
+  std::atomic<bool> *pStop = nullptr;
+  std::atomic<bool> *pSplitStop = nullptr; // set once any thread of a root split stops, so the others don't finish their moves for nothing.
+  std::atomic<size_t> *pSplitNodes = nullptr; // the node budget that's left to the threads of a root split, which they take from in chunks.
+  bool isStopped = false; // once set, every node returns right away and the results of the running iteration must be discarded.
+
+  alpha_beta_minimax_cache()
+  {
+#ifdef _DEBUG
+    for (size_t i = 0; i < MaxSearchDepth; i++)
+    {
+      stepMin[i] = InfiniteScore;
+      stepMax[i] = -InfiniteScore;
+    }
+#endif
+  }
+};
+
+lsResult alpha_beta_minimax_cache_create(alpha_beta_minimax_cache &cache)
+{
+  lsResult result = lsR_Success;
+
+  // The transposition table outlives the search, so it's only created here if nobody created (or loaded) it beforehand.
+  if (_TranspositionTable.pEntries == nullptr)
+    LS_ERROR_CHECK(transposition_table_create());
+
+  cache.pTranspositionTable = &_TranspositionTable;
+
+  LS_ERROR_CHECK(pawn_hash_table_create(cache.pawnHashTable));
+  LS_ERROR_CHECK(evaluation_cache_create(cache.evaluationCache));
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(cache.continuationHistory); i++)
+    LS_ERROR_CHECK(continuation_history_create(cache.continuationHistory[i]));
+
+epilogue:
+  return result;
+}
+
+void alpha_beta_minimax_cache_set_history(alpha_beta_minimax_cache &cache, const chess_board &board, const chess_history *pHistory)
+{
+  cache.hashHistoryRootIndex = 0;
+
+  if (pHistory == nullptr)
+    return;
+
+  // positions before the last irreversible move can't be repeated.
+  const size_t count = lsMin(pHistory->hashes.count, lsMin((size_t)board.halfMoveClock, cache.MaxHistoryLength));
+  lsMemcpy(cache.hashHistory, pHistory->hashes.pValues + pHistory->hashes.count - count, count);
+  cache.hashHistoryRootIndex = count;
+}
+
+// Prepares a cache that's kept across searches for the next one. Its move ordering statistics, pawn hash table and evaluation cache stay as they are, as they're still useful for the positions that come up next.
+void alpha_beta_minimax_cache_reset(alpha_beta_minimax_cache &cache)
+{
+  for (size_t i = 0; i < LS_ARRAYSIZE(cache.stack); i++)
+  {
+    search_stack_entry &entry = cache.stack[i];
+    entry.killers[0] = entry.killers[1] = chess_move();
+    entry.extensions = 0;
+    entry.isNullMove = false;
+    entry.hasExcludedMove = false;
+  }
+
+  lsZeroMemory(cache.ticksPerLayer, LS_ARRAYSIZE(cache.ticksPerLayer));
+
+  cache.rootLineCount = 0;
+  cache.rootLinesDepth = 0;
+  cache.rootExcludedMoveCount = 0;
+  cache.aspirationFailHighs = 0;
+  cache.aspirationFailLows = 0;
+  cache.threadIndex = 0;
+  cache.pRootSplit = nullptr;
+  cache.deferSearchingPositions = false;
+  cache.nullMoveMinPly = 0;
+  cache.rootDepth = 0;
+  cache.nodes = 0;
+  cache.maxNodes = 0;
+  cache.hardDeadlineNs = 0;
+  cache.pStop = nullptr;
+  cache.pSplitStop = nullptr;
+  cache.pSplitNodes = nullptr;
+  cache.isStopped = false;
+  cache.transpositionTableStats = transposition_table_stats();
+  cache.evaluationCache.hits = 0;
+  cache.evaluationCache.misses = 0;
+
+#ifdef _DEBUG
+  cache.nodesVisited = 0;
+  cache.quiescenceNodesVisited = 0;
+  cache.duplicatesRejected = 0;
+  cache.highestMoveCount = 0;
+  cache.lowestMoveCount = 0;
+  cache.lowestScore = InfiniteScore;
+  cache.highestScore = -InfiniteScore;
+  cache.pawnHashTable.hits = 0;
+  cache.pawnHashTable.misses = 0;
+
+  for (size_t i = 0; i < MaxSearchDepth; i++)
+  {
+    cache.stepMin[i] = InfiniteScore;
+    cache.stepMax[i] = -InfiniteScore;
+  }
+#endif
+}
+
+// Forgets what previous searches learned, so the next search runs as if the cache had just been created.
+void alpha_beta_minimax_cache_clear(alpha_beta_minimax_cache &cache)
+{
+  lsZeroMemory(cache.history, LS_ARRAYSIZE(cache.history));
+  lsZeroMemory(cache.counterMoves, LS_ARRAYSIZE(cache.counterMoves));
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(cache.continuationHistory); i++)
+    lsZeroMemory(cache.continuationHistory[i].pEntries, cache.continuationHistory[i].EntryCount);
+
+  pawn_hash_table_clear(cache.pawnHashTable);
+  evaluation_cache_clear(cache.evaluationCache);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+inline int16_t &alpha_beta_history_entry(alpha_beta_minimax_cache &cache, const bool isWhite, const chess_move move)
+{
+  return cache.history[isWhite][move.startY * BoardWidth + move.startX][move.targetY * BoardWidth + move.targetX];
+}
+
+// Returns `nullptr` if there's no move `pliesBack` plies before the one at `ply` to relate to.
+inline int16_t *alpha_beta_continuation_history_entry(alpha_beta_minimax_cache &cache, const chess_board &board, const size_t ply, const size_t pliesBack, const chess_move move)
+{
+  if (ply < pliesBack)
+    return nullptr;
+
+  const search_stack_entry &previous = cache.stack[ply - pliesBack];
+
+  if (previous.isNullMove)
+    return nullptr;
+
+  const chess_piece_type piece = board[vec2i8(move.startX, move.startY)].piece;
+  lsAssert(previous.movedPiece != cpT_none && piece != cpT_none);
+
+  const size_t previousIndex = (previous.movedPiece - 1) * BoardWidth * BoardWidth + previous.currentMove.targetY * BoardWidth + previous.currentMove.targetX;
+  const size_t index = (piece - 1) * BoardWidth * BoardWidth + move.targetY * BoardWidth + move.targetX;
+
+  return cache.continuationHistory[pliesBack - 1].pEntries + previousIndex * continuation_history::PieceTargetCount + index;
+}
+
+inline chess_move *alpha_beta_counter_move(alpha_beta_minimax_cache &cache, const chess_board &board, const size_t ply)
+{
+  if (ply == 0 || cache.stack[ply - 1].isNullMove)
+    return nullptr;
+
+  const search_stack_entry &previous = cache.stack[ply - 1];
+
+  return &cache.counterMoves[board.isWhitesTurn][previous.movedPiece][previous.currentMove.targetY * BoardWidth + previous.currentMove.targetX];
+}
+
+// History gravity: bonuses shrink the closer an entry already is to the limit, so entries saturate instead of overflowing and old results fade out.
+inline void alpha_beta_history_update(int16_t &entry, const int32_t bonus)
+{
+  entry = (int16_t)(entry + bonus - entry * lsAbs(bonus) / MaxHistoryScore);
+}
+
+inline int32_t alpha_beta_history_bonus(const size_t depth)
+{
+  return (int32_t)lsMin(depth * depth * 32, (size_t)2048);
+}
+
+// Butterfly history and both continuation histories combined, within +/- 3 * `MaxHistoryScore`.
+inline int32_t alpha_beta_quiet_move_history(alpha_beta_minimax_cache &cache, const chess_board &board, const size_t ply, const chess_move move)
+{
+  int32_t score = alpha_beta_history_entry(cache, board.isWhitesTurn, move);
+
+  for (size_t pliesBack = 1; pliesBack <= LS_ARRAYSIZE(cache.continuationHistory); pliesBack++)
+    if (const int16_t *pEntry = alpha_beta_continuation_history_entry(cache, board, ply, pliesBack, move))
+      score += *pEntry;
+
+  return score;
+}
+
+inline void alpha_beta_quiet_move_history_update(alpha_beta_minimax_cache &cache, const chess_board &board, const size_t ply, const chess_move move, const int32_t bonus)
+{
+  alpha_beta_history_update(alpha_beta_history_entry(cache, board.isWhitesTurn, move), bonus);
+
+  for (size_t pliesBack = 1; pliesBack <= LS_ARRAYSIZE(cache.continuationHistory); pliesBack++)
+    if (int16_t *pEntry = alpha_beta_continuation_history_entry(cache, board, ply, pliesBack, move))
+      alpha_beta_history_update(*pEntry, bonus);
+}
+
+// The cutoff move gets a history bonus and becomes a killer of its ply and the counter move of the previous move, the quiet moves that were searched before it without success get a malus.
+// Only the quiet moves that were actually searched before the one that caused the cutoff are penalized. Pruned ones didn't fail to cause it, and deferred ones may not have been searched yet.
+void alpha_beta_record_quiet_cutoff(alpha_beta_minimax_cache &cache, const chess_board &board, const size_t ply, const size_t depth, const size_t moveIndex, const uint8_t *pSearchedQuietMoveIndices, const size_t searchedQuietMoveCount)
+{
+  search_stack_entry &stackEntry = cache.stack[ply];
+  const chess_move move = stackEntry.moves[moveIndex];
+  const int32_t bonus = alpha_beta_history_bonus(depth);
+
+  if (!(stackEntry.killers[0] == move))
+  {
+    stackEntry.killers[1] = stackEntry.killers[0];
+    stackEntry.killers[0] = move;
+  }
+
+  if (chess_move *pCounterMove = alpha_beta_counter_move(cache, board, ply))
+    *pCounterMove = move;
+
+  alpha_beta_quiet_move_history_update(cache, board, ply, move, bonus);
+
+  for (size_t i = 0; i < searchedQuietMoveCount; i++)
+    alpha_beta_quiet_move_history_update(cache, board, ply, stackEntry.moves[pSearchedQuietMoveIndices[i]], -bonus);
+}
+
+constexpr size_t MaxOrderedMoves = 256;
+
+// Captures that don't lose material come first in MVV/LVA order, followed by the other moves sorted by promotions, killers, the counter move and history score.
+// Captures that lose material according to the static exchange evaluation come last.
+void alpha_beta_order_moves(alpha_beta_minimax_cache &cache, const chess_board &board, const size_t ply)
+{
+  search_stack_entry &stackEntry = cache.stack[ply];
+  list<chess_move> &moves = stackEntry.moves;
+
+  size_t captureCount = 0;
+
+  while (captureCount < moves.count && board[vec2i8(moves[captureCount].targetX, moves[captureCount].targetY)].piece != cpT_none)
+    captureCount++;
+
+  chess_move losingCaptures[MaxOrderedMoves];
+  size_t losingCaptureCount = 0;
+  size_t first = 0;
+
+  for (size_t i = 0; i < captureCount; i++)
+  {
+    if (losingCaptureCount < MaxOrderedMoves && static_exchange_evaluation(board, moves[i]) < 0)
+      losingCaptures[losingCaptureCount++] = moves[i];
+    else
+      moves[first++] = moves[i];
+  }
+
+  lsMemmove(moves.pValues + first, moves.pValues + captureCount, moves.count - captureCount);
+  lsMemcpy(moves.pValues + moves.count - losingCaptureCount, losingCaptures, losingCaptureCount);
+
+  const size_t count = lsMin(moves.count - first - losingCaptureCount, MaxOrderedMoves);
+  chess_move *pMoves = moves.pValues + first;
+  int32_t scores[MaxOrderedMoves];
+
+  const chess_move *pCounterMove = alpha_beta_counter_move(cache, board, ply);
+  const chess_move counterMove = pCounterMove != nullptr ? *pCounterMove : chess_move();
+
+  for (size_t i = 0; i < count; i++)
+  {
+    if (pMoves[i].isPromotion)
+      scores[i] = MaxHistoryScore * 6 + pMoves[i].isPromotedToQueen;
+    else if (!is_quiet_move(board, pMoves[i])) // en passant.
+      scores[i] = MaxHistoryScore * 5;
+    else if (stackEntry.killers[0] == pMoves[i])
+      scores[i] = MaxHistoryScore * 4 + 2;
+    else if (stackEntry.killers[1] == pMoves[i])
+      scores[i] = MaxHistoryScore * 4 + 1;
+    else if (pMoves[i] == counterMove)
+      scores[i] = MaxHistoryScore * 4;
+    else
+      scores[i] = alpha_beta_quiet_move_history(cache, board, ply, pMoves[i]);
+  }
+
+  // insertion sort, as it's stable and the lists are short.
+  for (size_t i = 1; i < count; i++)
+  {
+    const chess_move move = pMoves[i];
+    const int32_t score = scores[i];
+    size_t j = i;
+
+    for (; j > 0 && scores[j - 1] < score; j--)
+    {
+      pMoves[j] = pMoves[j - 1];
+      scores[j] = scores[j - 1];
+    }
+
+    pMoves[j] = move;
+    scores[j] = score;
+  }
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Time and the stop flag are only polled every so often, as reading the clock isn't free.
+constexpr size_t SearchStopPollInterval = 2048;
+
+// Threads of a root split take their nodes from the budget of the split in chunks, so none of them runs out while the others still have nodes left.
+// The chunks shrink along with the budget, so the nodes other threads hold on to when one of them runs out are a small fraction of it.
+constexpr size_t SplitNodeMaxChunkSize = 256;
+constexpr size_t SplitNodeChunkDivisor = 64;
+
+// Raises the node limit of `cache` by the next chunk of the split budget. Returns false once the split as a whole is out of nodes.
+inline bool alpha_beta_take_split_nodes(alpha_beta_minimax_cache &cache)
+{
+  if (cache.pSplitNodes == nullptr)
+    return false;
+
+  size_t available = cache.pSplitNodes->load(std::memory_order_relaxed);
+  size_t taken;
+
+  do
+  {
+    if (available == 0)
+      return false;
+
+    taken = lsClamp(available / SplitNodeChunkDivisor, (size_t)1, SplitNodeMaxChunkSize);
+  } while (!cache.pSplitNodes->compare_exchange_weak(available, available - taken, std::memory_order_relaxed));
+
+  cache.maxNodes += taken;
+  return true;
+}
+
+inline bool alpha_beta_should_stop(alpha_beta_minimax_cache &cache)
+{
+  cache.nodes++;
+
+  if (cache.isStopped)
+    return true;
+
+  if (cache.maxNodes != 0 && cache.nodes >= cache.maxNodes)
+    cache.isStopped = !alpha_beta_take_split_nodes(cache);
+  else if ((cache.nodes & (SearchStopPollInterval - 1)) == 0)
+    cache.isStopped = (cache.pStop != nullptr && cache.pStop->load(std::memory_order_relaxed)) || (cache.pSplitStop != nullptr && cache.pSplitStop->load(std::memory_order_relaxed)) || (cache.hardDeadlineNs != 0 && lsGetCurrentTimeNs() >= cache.hardDeadlineNs);
+
+  return cache.isStopped;
+}
+
+inline bool alpha_beta_is_draw(const chess_board &board, const alpha_beta_minimax_cache &cache, const size_t ply)
+{
+  if (board.halfMoveClock >= FiftyMoveRulePlies)
+    return true;
+
+  const size_t index = cache.hashHistoryRootIndex + ply;
+  const size_t scanLength = lsMin((size_t)board.halfMoveClock, index);
+
+  // Only positions with the same side to move can match, and getting back to one takes at least four plies.
+  for (size_t i = 4; i <= scanLength; i += 2)
+    if (cache.hashHistory[index - i] == board.hash)
+      return true;
+
+  return false;
+}
+
+// The search scores positions from the perspective of the side to move, the evaluation is always white relative.
+inline int64_t alpha_beta_evaluate(const chess_board &board, alpha_beta_minimax_cache &cache)
+{
+  const int64_t score = evaluate_chess_board(board, cache.evaluationCache, cache.pawnHashTable);
+  return board.isWhitesTurn ? score : -score;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+constexpr int64_t QuiescenceDeltaMargin = 200; // positional compensation a capture could bring on top of the captured material.
+constexpr size_t QuiescenceMaxCheckEvasionDepth = 4; // deeper down, checks are ignored, as chains of evasions that give check themselves could otherwise grow exponentially.
+
+// Resolves captures until the position is quiet. The side to move may always stand pat on the static evaluation instead of capturing, except when in check, where all moves are searched to find an evasion.
+int32_t quiescence_alpha_beta_step(const chess_board &board, int32_t alpha, const int32_t beta, const size_t ply, alpha_beta_minimax_cache &cache, const size_t depthIndex = 0)
+{
+  if (alpha_beta_should_stop(cache))
+    return 0;
+
+  // The opponent has just taken our king.
+  if (board.hasWhiteWon || board.hasBlackWon)
+    return -MateScore + (int32_t)ply;
+  else if (depthIndex == MaxQuiescenceDepth)
+    return (int32_t)alpha_beta_evaluate(board, cache);
+
+  const bool isInCheck = depthIndex < QuiescenceMaxCheckEvasionDepth && is_in_check(board);
+
+  int32_t score = -InfiniteScore;
+  int64_t standPat = 0;
+
+  if (!isInCheck)
+  {
+    standPat = alpha_beta_evaluate(board, cache);
+    score = (int32_t)standPat;
+
+    if (score >= beta)
+      return score;
+
+    if (score > alpha)
+      alpha = score;
+  }
+
+  list<chess_move> &moves = cache.stack[ply].moves;
+
+  if (isInCheck)
+    LS_DEBUG_ERROR_ASSERT(get_all_valid_ordered_moves(moves, board, cache.pieceMoves[0], cache.pieceMovesWithNonCapture));
+  else
+    LS_DEBUG_ERROR_ASSERT(get_valid_quiescence_moves(moves, board, cache.pieceMoves[0], cache.pieceMoves[1]));
+
+  for (const chess_move move : moves)
+  {
+    if (!isInCheck)
+    {
+      // Delta pruning: captures that can't raise alpha even with a positional bonus on top of the captured piece aren't worth searching.
+      const int64_t capturedScore = PieceScores[board[vec2i8(move.targetX, move.targetY)].piece] + (move.isPromotion ? PieceScores[cpT_queen] - PieceScores[cpT_pawn] : 0);
+
+      if (standPat + capturedScore + QuiescenceDeltaMargin < alpha)
+        continue;
+
+      // captures that lose material are very unlikely to improve anything.
+      if (static_exchange_evaluation(board, move) < 0)
+        continue;
+    }
+
 #ifdef _DEBUG
     cache.quiescenceNodesVisited++;
 #endif
 
-    const chess_board after = perform_move(board, move);
-    cache.currentMove[CacheDepth + depthIndex] = move;
+    const chess_board after = perform_move(board, move);
+    cache.stack[ply].currentMove = move;
+
+    const int32_t moveScore = -quiescence_alpha_beta_step(after, -beta, -alpha, ply + 1, cache, depthIndex + 1);
+
+    if (cache.isStopped)
+      return 0;
+
+    if (moveScore > score)
+    {
+      score = moveScore;
+
+      if (score > alpha)
+        alpha = score;
+
+      if (score >= beta)
+        break;
+    }
+  }
+
+  if (score == -InfiniteScore)
+    return (int32_t)alpha_beta_evaluate(board, cache);
+
+  return score;
+}
+
+constexpr bool UseQuiescenceSearch = true;
+
+constexpr bool UseNullMovePruning = true;
+constexpr size_t NullMoveMinDepth = 3;
+constexpr size_t NullMoveVerificationMinDepth = 10; // below this depth null move cutoffs are trusted without verification.
+
+// Adaptive null move reduction: deeper subtrees can afford to be reduced more.
+inline size_t null_move_reduction(const size_t depth)
+{
+  return depth > 6 ? 3 : 2;
+}
+
+// Shallow depth pruning: close to the horizon, nodes and moves that are very unlikely to change the result are pruned based on the static evaluation.
+constexpr bool UseShallowDepthPruning = true;
+constexpr size_t ReverseFutilityMaxDepth = 6;
+constexpr int64_t ReverseFutilityMargin = 120; // per remaining ply.
+constexpr size_t RazoringMaxDepth = 2;
+constexpr int64_t RazoringMargin = 300; // per remaining ply.
+constexpr size_t FutilityMaxDepth = 3;
+constexpr int64_t FutilityMargin[FutilityMaxDepth + 1] = { 0, 150, 300, 500 }; // [depth]
+constexpr size_t LateMovePruningMaxDepth = 3;
+constexpr size_t LateMovePruningBaseMoveCount = 4;
+
+// Quiet moves after this many moves are pruned at shallow depths.
+inline size_t late_move_pruning_move_count(const size_t depth)
+{
+  return LateMovePruningBaseMoveCount + depth * depth * 2;
+}
+
+constexpr bool UseCheckExtensions = true;
+constexpr bool UseSingularExtensions = true;
+constexpr size_t SingularExtensionMinDepth = 6;
+constexpr size_t SingularExtensionMaxEntryDepthDifference = 3; // the transposition table entry may be this much shallower than the current search.
+constexpr int64_t SingularExtensionMargin = 4; // per remaining ply.
+
+constexpr bool UseLateMoveReductions = true;
+constexpr size_t LateMoveReductionMinDepth = 3;
+constexpr size_t LateMoveReductionMinMoveIndex = 3; // the first moves are the most likely to be best, so they're never reduced.
+constexpr size_t LateMoveReductionMaxMoveIndex = 64;
+constexpr float LateMoveReductionBase = 0.75f;
+constexpr float LateMoveReductionDivisor = 2.25f;
+
+// Reductions grow with the logarithm of both the remaining depth and the position of the move in the ordered move list.
+struct late_move_reduction_table
+{
+  uint8_t reduction[MaxSearchDepth + 1][LateMoveReductionMaxMoveIndex];
+
+  late_move_reduction_table()
+  {
+    for (size_t depth = 0; depth <= MaxSearchDepth; depth++)
+    {
+      for (size_t moveIndex = 0; moveIndex < LateMoveReductionMaxMoveIndex; moveIndex++)
+      {
+        if (depth == 0 || moveIndex == 0)
+          reduction[depth][moveIndex] = 0;
+        else
+          reduction[depth][moveIndex] = (uint8_t)lsMax(0.f, LateMoveReductionBase + lsLog((float)depth) * lsLog((float)moveIndex) / LateMoveReductionDivisor);
+      }
+    }
+  }
+};
+
+static const late_move_reduction_table LateMoveReductions;
+
+inline size_t late_move_reduction(const size_t depth, const size_t moveIndex, const bool isPvNode, const bool givesCheck, const bool isRefutation, const int32_t historyScore) // `historyScore` as returned by `alpha_beta_quiet_move_history`.
+{
+  size_t reduction = LateMoveReductions.reduction[depth][lsMin(moveIndex, LateMoveReductionMaxMoveIndex - 1)];
+
+  // principal variation nodes, checks, killers, counter moves and moves that often caused cutoffs are more likely to matter, so they're reduced less.
+  if (isPvNode && reduction > 0)
+    reduction--;
+
+  if (givesCheck && reduction > 0)
+    reduction--;
+
+  if (isRefutation && reduction > 0)
+    reduction--;
+
+  if (historyScore > MaxHistoryScore && reduction > 0)
+    reduction--;
+  else if (historyScore < -MaxHistoryScore)
+    reduction++;
+
+  return lsMin(reduction, depth - 1);
+}
+
+// ABDADA (simplified): threads mark the positions they are currently searching, so the others defer moves leading there until the rest of the node is searched. The first move of a node is never deferred, as its score is needed to search the others efficiently.
+// Shallow subtrees are done before deferring them would pay off, so they aren't marked. Entries may be overwritten or go missing when threads race, which only costs some duplicate work.
+constexpr size_t AbdadaMinDepth = 3;
+
+struct searching_position_table
+{
+  constexpr static size_t hashBits = 13;
+  constexpr static size_t hashValues = (1ULL << hashBits);
+  constexpr static size_t hashMask = hashValues - 1;
+  constexpr static size_t ways = 4;
+
+  std::atomic<uint64_t> hashes[hashValues][ways] = {}; // zero marks an empty way.
+};
+
+static searching_position_table _SearchingPositions;
+
+inline bool searching_positions_contains(const uint64_t hash)
+{
+  std::atomic<uint64_t> *pWays = _SearchingPositions.hashes[hash & _SearchingPositions.hashMask];
+
+  for (size_t i = 0; i < _SearchingPositions.ways; i++)
+    if (pWays[i].load(std::memory_order_relaxed) == hash)
+      return true;
+
+  return false;
+}
+
+inline void searching_positions_add(const uint64_t hash)
+{
+  std::atomic<uint64_t> *pWays = _SearchingPositions.hashes[hash & _SearchingPositions.hashMask];
+
+  for (size_t i = 0; i < _SearchingPositions.ways; i++)
+  {
+    const uint64_t entry = pWays[i].load(std::memory_order_relaxed);
+
+    if (entry == hash)
+      return;
+
+    if (entry == 0)
+    {
+      pWays[i].store(hash, std::memory_order_relaxed);
+      return;
+    }
+  }
+
+  pWays[0].store(hash, std::memory_order_relaxed);
+}
+
+inline void searching_positions_remove(const uint64_t hash)
+{
+  std::atomic<uint64_t> *pWays = _SearchingPositions.hashes[hash & _SearchingPositions.hashMask];
+
+  for (size_t i = 0; i < _SearchingPositions.ways; i++)
+    if (pWays[i].load(std::memory_order_relaxed) == hash)
+      pWays[i].store(0, std::memory_order_relaxed);
+}
+
+inline bool alpha_beta_is_root_move_excluded(const alpha_beta_minimax_cache &cache, const chess_move move)
+{
+  for (size_t i = 0; i < cache.rootExcludedMoveCount; i++)
+    if (cache.rootExcludedMoves[i] == move)
+      return true;
+
+  return false;
+}
+
+// Makes `move` followed by the principal variation of the child just searched the principal variation of `ply`.
+inline void alpha_beta_update_pv(alpha_beta_minimax_cache &cache, const size_t ply, const chess_move move)
+{
+  const size_t childLength = lsMax(cache.pvLength[ply + 1], ply + 1);
+
+  cache.pv[ply][ply] = move;
+
+  for (size_t i = ply + 1; i < childLength; i++)
+    cache.pv[ply][i] = cache.pv[ply + 1][i];
+
+  cache.pvLength[ply] = childLength;
+}
+
+int32_t alpha_beta_step(const chess_board &board, int32_t alpha, int32_t beta, const size_t depth, const size_t ply, alpha_beta_minimax_cache &cache);
+
+// Principal variation search of a move after the first one: the others are expected to be worse, which a null window around alpha proves more cheaply.
+// Those that turn out to be better (but not good enough for a cutoff) are searched again with the full window to get their actual score.
+inline int32_t alpha_beta_search_later_move(const chess_board &board, const chess_board &after, const chess_move move, const size_t moveIndex, const int32_t alpha, const int32_t beta, const size_t depth, const size_t childDepth, const size_t ply, const bool isInCheck, const bool isPvNode, const bool givesCheck, const bool isQuiet, alpha_beta_minimax_cache &cache)
+{
+  const search_stack_entry &stackEntry = cache.stack[ply];
 
-    const score_with_depth moveScore = quiescence_alpha_beta_step<!FindMin, CacheDepth, MaxDepth>(after, alpha, beta, cache, depthIndex + 1);
+  // Late move reductions: quiet moves late in the ordering rarely turn out best, so they're searched shallower first and only searched to the full depth if they unexpectedly fail high.
+  size_t reduction = 0;
 
-    if constexpr (FindMin)
+  if constexpr (UseLateMoveReductions)
+    if (depth >= LateMoveReductionMinDepth && moveIndex >= LateMoveReductionMinMoveIndex && !isInCheck && isQuiet)
     {
-      if (moveScore < score)
-      {
-        score = moveScore;
+      const chess_move *pCounterMove = alpha_beta_counter_move(cache, board, ply);
+      const bool isRefutation = stackEntry.killers[0] == move || stackEntry.killers[1] == move || (pCounterMove != nullptr && *pCounterMove == move);
 
-        if (score < beta)
-          beta = score;
+      reduction = late_move_reduction(depth, moveIndex, isPvNode, givesCheck, isRefutation, alpha_beta_quiet_move_history(cache, board, ply, move));
+    }
 
-        if (score <= alpha)
-          break;
-      }
+  int32_t score = -alpha_beta_step(after, -alpha - 1, -alpha, childDepth - reduction, ply + 1, cache);
+
+  if (!cache.isStopped && reduction > 0 && score > alpha)
+    score = -alpha_beta_step(after, -alpha - 1, -alpha, childDepth, ply + 1, cache);
+
+  if (!cache.isStopped && score > alpha && score < beta)
+    score = -alpha_beta_step(after, -beta, -alpha, childDepth, ply + 1, cache);
+
+  return score;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Root splitting: once the first root move established alpha, the remaining ones are taken one by one by the threads of the split, which all search them against the best score so far.
+// Each thread has its own cache (and with it its own search stack and move ordering statistics), only the transposition table is shared.
+struct root_split
+{
+  thread_pool *pThreadPool = nullptr;
+  alpha_beta_minimax_cache *pWorkerCaches[MaxSearchThreads - 1] = {};
+  size_t workerCount = 0; // the main thread searches root moves as well.
+  std::atomic<bool> stop = false;
+  std::atomic<size_t> nodes = 0; // the node budget that's left to the running split, if the search has one.
+
+  // The state of the running split. The best score and line are guarded by `mutex`.
+  std::mutex mutex;
+  std::atomic<size_t> nextMoveIndex = 0;
+  std::atomic<int32_t> alpha = 0;
+  std::atomic<bool> isCutoff = false;
+  int32_t bestScore = 0;
+  size_t bestMoveIndex = 0;
+  chess_move pv[MaxSearchDepth + 1];
+  size_t pvLength = 0;
+};
+
+// Takes the next root move of the running split until none are left, the root fails high or the search is stopped. `rootCache` is the cache of the main thread, which holds the root moves.
+void alpha_beta_root_split_search(root_split &split, const chess_board &board, const int32_t beta, const size_t depth, const bool isInCheck, const bool isPvNode, const bool canExtend, const alpha_beta_minimax_cache &rootCache, alpha_beta_minimax_cache &cache)
+{
+  const list<chess_move> &moves = rootCache.stack[0].moves;
+  search_stack_entry &stackEntry = cache.stack[0];
+
+  cache.rootDepth = depth;
+  cache.hashHistory[cache.hashHistoryRootIndex] = board.hash;
+  stackEntry.extensions = 0;
+  stackEntry.isNullMove = false;
+  stackEntry.hasExcludedMove = false;
+
+  // a thread that didn't get a chunk of the node budget leaves the moves to the ones that did.
+  if (cache.isStopped)
+    return;
+
+  while (!split.isCutoff.load(std::memory_order_relaxed))
+  {
+    const size_t moveIndex = split.nextMoveIndex++;
+
+    if (moveIndex >= moves.count)
+      break;
+
+    const chess_move move = moves[moveIndex];
+
+    if (alpha_beta_is_root_move_excluded(rootCache, move))
+      continue;
+
+    const chess_board after = perform_move(board, move);
+    stackEntry.currentMove = move;
+    stackEntry.movedPiece = board[vec2i8(move.startX, move.startY)].piece;
+
+    int32_t score;
+
+    if (micro_starting_board_find(after, pStartingBoardHashMap, StartingBoardHashCount))
+    {
+      score = InfiniteScore;
+      cache.pvLength[1] = 1;
     }
     else
     {
-      if (moveScore > score)
+      const bool givesCheck = is_in_check(after);
+      const size_t extension = (canExtend && UseCheckExtensions && givesCheck && static_exchange_evaluation(board, move) >= 0) ? 1 : 0;
+      cache.stack[1].extensions = extension;
+
+      score = alpha_beta_search_later_move(board, after, move, moveIndex, split.alpha.load(), beta, depth, depth - 1 + extension, 0, isInCheck, isPvNode, givesCheck, is_quiet_move(board, move), cache);
+    }
+
+    if (cache.isStopped)
+    {
+      split.stop = true;
+      break;
+    }
+
+    std::lock_guard<std::mutex> lock(split.mutex);
+
+    if (score > split.bestScore)
+    {
+      split.bestScore = score;
+      split.bestMoveIndex = moveIndex;
+
+      if (score > split.alpha)
       {
-        score = moveScore;
+        split.alpha = score;
+        alpha_beta_update_pv(cache, 0, move);
 
-        if (score > alpha)
-          alpha = score;
+        split.pvLength = cache.pvLength[0];
 
-        if (score >= beta)
-          break;
+        for (size_t i = 0; i < split.pvLength; i++)
+          split.pv[i] = cache.pv[0][i];
       }
+
+      if (score >= beta)
+        split.isCutoff = true;
     }
   }
 
-  return score;
+  // the rest of the chunk goes back to the threads that are still searching.
+  if (cache.pSplitNodes != nullptr && cache.maxNodes > cache.nodes)
+  {
+    *cache.pSplitNodes += cache.maxNodes - cache.nodes;
+    cache.maxNodes = cache.nodes;
+  }
 }
 
-constexpr bool UseQuiescenceSearch = true;
+// Searches the root moves from `firstMoveIndex` on with all threads of the split and returns the best score of the root, including `bestScore` of the moves before.
+// Like the move loop of `alpha_beta_step`, it updates the best move and principal variation of the root.
+int32_t alpha_beta_root_split(const chess_board &board, const int32_t alpha, const int32_t beta, const size_t depth, const size_t firstMoveIndex, const int32_t bestScore, const bool isInCheck, const bool isPvNode, const bool canExtend, alpha_beta_minimax_cache &cache)
+{
+  root_split &split = *cache.pRootSplit;
+  search_stack_entry &stackEntry = cache.stack[0];
+  const size_t noMoveIndex = (size_t)-1;
 
-template <bool FindMin, size_t MaxDepth, size_t CacheDepth, size_t DepthIndex = 0>
-moves_with_score<CacheDepth> alpha_beta_step(const chess_board &board, score_with_depth alpha, score_with_depth beta, alpha_beta_minimax_cache<CacheDepth> &cache)
+  split.nextMoveIndex = firstMoveIndex;
+  split.alpha = alpha;
+  split.isCutoff = false;
+  split.bestScore = bestScore;
+  split.bestMoveIndex = noMoveIndex;
+  split.pvLength = cache.pvLength[0];
+
+  for (size_t i = 0; i < split.pvLength; i++)
+    split.pv[i] = cache.pv[0][i];
+
+  // The threads of the split, this one included, take the remaining node budget in chunks, so together they don't exceed it, but the iteration only stops once all of it is used up.
+  const size_t maxNodes = cache.maxNodes;
+
+  if (maxNodes != 0)
+  {
+    split.nodes = maxNodes - lsMin(cache.nodes, maxNodes);
+    cache.maxNodes = cache.nodes;
+    cache.pSplitNodes = &split.nodes;
+
+    if (!alpha_beta_take_split_nodes(cache))
+      cache.isStopped = true;
+  }
+
+  for (size_t i = 0; i < split.workerCount; i++)
+  {
+    alpha_beta_minimax_cache &workerCache = *split.pWorkerCaches[i];
+
+    workerCache.nodes = 0;
+    workerCache.maxNodes = 0;
+    workerCache.pSplitNodes = maxNodes != 0 ? &split.nodes : nullptr;
+    workerCache.isStopped = maxNodes != 0 && !alpha_beta_take_split_nodes(workerCache);
+
+    thread_pool_add(split.pThreadPool, [&, i]() { alpha_beta_root_split_search(split, board, beta, depth, isInCheck, isPvNode, canExtend, cache, *split.pWorkerCaches[i]); });
+  }
+
+  alpha_beta_root_split_search(split, board, beta, depth, isInCheck, isPvNode, canExtend, cache, cache);
+
+  thread_pool_await(split.pThreadPool);
+  cache.maxNodes = maxNodes;
+  cache.pSplitNodes = nullptr;
+
+  for (size_t i = 0; i < split.workerCount; i++)
+  {
+    alpha_beta_minimax_cache &workerCache = *split.pWorkerCaches[i];
+
+    cache.nodes += workerCache.nodes;
+    transposition_table_stats_add(cache.transpositionTableStats, workerCache.transpositionTableStats);
+    workerCache.transpositionTableStats = transposition_table_stats();
+  }
+
+  if (split.stop)
+  {
+    cache.isStopped = true;
+    return 0;
+  }
+
+  if (split.bestMoveIndex != noMoveIndex)
+  {
+    stackEntry.bestMove = stackEntry.moves[split.bestMoveIndex];
+
+    if (split.bestScore >= beta && is_quiet_move(board, stackEntry.bestMove))
+    {
+      // the threads take the moves in order, so all of the ones before the best move that weren't excluded have been searched (or were aborted because of it).
+      uint8_t searchedQuietMoveIndices[MaxOrderedMoves];
+      size_t searchedQuietMoveCount = 0;
+
+      for (size_t i = 0; i < split.bestMoveIndex; i++)
+        if (is_quiet_move(board, stackEntry.moves[i]) && !alpha_beta_is_root_move_excluded(cache, stackEntry.moves[i]))
+          searchedQuietMoveIndices[searchedQuietMoveCount++] = (uint8_t)i;
+
+      alpha_beta_record_quiet_cutoff(cache, board, 0, depth, split.bestMoveIndex, searchedQuietMoveIndices, searchedQuietMoveCount);
+    }
+  }
+
+  cache.pvLength[0] = split.pvLength;
+
+  for (size_t i = 0; i < split.pvLength; i++)
+    cache.pv[0][i] = split.pv[i];
+
+  return split.bestScore;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+// Negamax: scores are relative to the side to move and the score of a child is the negated score of its parent.
+// `depth` is the remaining search depth, `ply` the distance to the root. The best move of each ply ends up in `cache.stack[ply].bestMove`, the line leading to the score in `cache.pv[ply]`.
+int32_t alpha_beta_step(const chess_board &board, int32_t alpha, int32_t beta, const size_t depth, const size_t ply, alpha_beta_minimax_cache &cache)
 {
-  static_assert(DepthIndex <= MaxDepth);
+  lsAssert(ply + depth <= MaxSearchDepth);
+
+  cache.pvLength[ply] = ply;
 
-  constexpr size_t CacheDepthIndex = (CacheDepth - MaxDepth) + DepthIndex;
+  if (alpha_beta_should_stop(cache))
+    return 0;
 
-  if constexpr (FindMin)
-    if (board.hasWhiteWon)
-      return moves_with_score<CacheDepth>(cache.currentMove, score_with_depth(PieceScores[cpT_king], CacheDepthIndex));
+  // The opponent has just taken our king.
+  if (board.hasWhiteWon || board.hasBlackWon)
+    return -MateScore + (int32_t)ply;
+
+  cache.hashHistory[cache.hashHistoryRootIndex + ply] = board.hash;
+
+  // Repeating a position (once) or running into the fifty move rule is scored as a draw right away, so cycles aren't searched again and again.
+  if (ply > 0 && alpha_beta_is_draw(board, cache, ply))
+    return 0;
+
+  // Mate distance pruning: no line through this node can be better than taking the king on the next ply or worse than having lost it already, so a window outside of that can't be improved on.
+  if (ply > 0)
+  {
+    alpha = lsMax(alpha, -MateScore + (int32_t)ply);
+    beta = lsMin(beta, MateScore - (int32_t)ply - 1);
 
-  if constexpr (!FindMin)
-    if (board.hasBlackWon)
-      return moves_with_score<CacheDepth>(cache.currentMove, score_with_depth(-PieceScores[cpT_king], CacheDepthIndex));
+    if (alpha >= beta)
+      return alpha;
+  }
 
-  if constexpr (DepthIndex == MaxDepth)
+  if (depth == 0)
   {
-    score_with_depth score;
+    int32_t score;
     const int64_t begin = __rdtsc();
 
     if constexpr (UseQuiescenceSearch)
-      score = quiescence_alpha_beta_step<!FindMin>(board, alpha, beta, cache);
+      score = quiescence_alpha_beta_step(board, alpha, beta, ply, cache);
     else
-      score = score_with_depth(evaluate_chess_board(board), CacheDepthIndex);
-
-    const moves_with_score<CacheDepth> ret = moves_with_score<CacheDepth>(cache.currentMove, score);
+      score = (int32_t)alpha_beta_evaluate(board, cache);
 
 #ifdef _DEBUG
-    if (ret.score > cache.highestScore)
+    const int32_t whiteScore = board.isWhitesTurn ? score : -score;
+
+    if (whiteScore > cache.highestScore)
     {
-      lsMemcpy(cache.highestMove, cache.currentMove, CacheDepth);
-      cache.highestScore = ret.score;
+      for (size_t i = 0; i < ply; i++)
+        cache.highestMove[i] = cache.stack[i].currentMove;
+
+      cache.highestMoveCount = ply;
+      cache.highestScore = whiteScore;
     }
 
-    if (ret.score < cache.lowestScore)
+    if (whiteScore < cache.lowestScore)
     {
-      lsMemcpy(cache.lowestMove, cache.currentMove, CacheDepth);
-      cache.lowestScore = ret.score;
+      for (size_t i = 0; i < ply; i++)
+        cache.lowestMove[i] = cache.stack[i].currentMove;
+
+      cache.lowestMoveCount = ply;
+      cache.lowestScore = whiteScore;
     }
 #endif
 
     const int64_t end = __rdtsc();
-    cache.ticksPerLayer[DepthIndex] += end - begin;
+    cache.ticksPerLayer[ply] += end - begin;
 
-    return ret;
+    return score;
   }
-  else
+
+  const int64_t begin = __rdtsc();
+
+  if (ply == 0)
   {
-    const int64_t begin = __rdtsc();
+    cache.rootDepth = depth;
+    cache.stack[0].extensions = 0;
+  }
 
-    list<chess_move> &moves = cache.movesAtLevel[DepthIndex];
-    LS_DEBUG_ERROR_ASSERT(get_all_valid_ordered_moves(moves, board, cache.pieceMoves[0], cache.pieceMovesWithNonCapture));
-    moves_with_score<CacheDepth> ret;
-    ret.score = FindMin ? score_with_depth(lsMaxValue<int64_t>(), CacheDepth + cache.MaxQuiescenceDepth) : score_with_depth(lsMinValue<int64_t>(), CacheDepth + cache.MaxQuiescenceDepth);
+  search_stack_entry &stackEntry = cache.stack[ply];
 
-    for (const chess_move move : moves)
+  // An exclusion search of this node (for singular extensions or further lines at the root) searches all but the excluded moves, so its result must neither come from nor go into the transposition table.
+  const bool isExclusionSearch = stackEntry.hasExcludedMove || (ply == 0 && cache.rootExcludedMoveCount > 0);
+
+  const int32_t alphaOriginal = alpha;
+  const uint64_t hash = board.hash;
+  bool entryMatches;
+  transposition_table_entry entry; // the slot may be replaced by the stores of the subtrees (and other threads), so the entry is copied.
+  transposition_table_entry *pSlot = transposition_table_probe(*cache.pTranspositionTable, cache.transpositionTableStats, hash, &entry, &entryMatches);
+
+  const chess_move entryMove = entryMatches ? entry.move : chess_move();
+  const int32_t entryScore = entryMatches ? transposition_table_entry_score(entry, ply) : 0;
+  const transposition_table_bound entryBound = entryMatches ? (transposition_table_bound)entry.bound : ttb_upper;
+  const size_t entryDepth = entryMatches ? entry.depth : 0;
+
+  // the root has to actually search it's moves, as the opening book is checked there and we need a best move.
+  if (ply > 0 && !isExclusionSearch && entryMatches && entryDepth >= depth)
+  {
+    if (entryBound == ttb_exact || (entryBound == ttb_lower && entryScore >= beta) || (entryBound == ttb_upper && entryScore <= alpha))
     {
-#ifdef _DEBUG
-      cache.nodesVisited++;
-#endif
+      cache.transpositionTableStats.cutoffs++;
+      cache.stack[ply].bestMove = entryMove;
+      return entryScore;
+    }
+  }
 
-      const chess_board after = perform_move(board, move);
-      cache.currentMove[CacheDepthIndex] = move;
+  stackEntry.isNullMove = false;
+
+  // the children of this node only share killers among themselves, the ones of other subtrees don't apply to them.
+  if (ply + 1 < MaxSearchPly)
+    cache.stack[ply + 1].killers[0] = cache.stack[ply + 1].killers[1] = chess_move();
+
+  const bool isInCheck = is_in_check(board);
+  const bool isPvNode = beta > alpha + 1;
+  const int64_t staticEval = alpha_beta_evaluate(board, cache);
+  const bool canPruneShallow = UseShallowDepthPruning && ply > 0 && !isPvNode && !isInCheck && !is_mate_score(alpha) && !is_mate_score(beta);
 
-      if constexpr (DepthIndex == 0)
-        if (micro_starting_board_find(after, pStartingBoardHashMap, StartingBoardHashCount))
-          return moves_with_score<CacheDepth>(cache.currentMove, score_with_depth(lsMaxValue<int64_t>(), CacheDepthIndex));
+  if (canPruneShallow)
+  {
+    // Reverse futility pruning: if the static evaluation exceeds beta by a margin the opponent is unlikely to make up for in the remaining plies, this node fails high.
+    if (depth <= ReverseFutilityMaxDepth && staticEval - ReverseFutilityMargin * (int64_t)depth >= beta)
+      return (int32_t)staticEval;
+
+    // Razoring: if the static evaluation is far below alpha, only captures are likely to save the position, so quiescence search decides.
+    if (depth <= RazoringMaxDepth && staticEval + RazoringMargin * (int64_t)depth < alpha)
+    {
+      const int32_t score = quiescence_alpha_beta_step(board, alpha, alpha + 1, ply, cache);
+
+      if (cache.isStopped)
+        return 0;
+
+      if (score <= alpha)
+        return score;
+    }
+  }
+
+  // Null move pruning: if passing the turn still fails high at a reduced depth, actually moving is assumed to be even better.
+  // That doesn't hold in zugzwang, so it's skipped in check, with only pawns left and right after another null move.
+  if constexpr (UseNullMovePruning)
+  {
+    if (ply > 0 && !isExclusionSearch && ply >= cache.nullMoveMinPly && depth >= NullMoveMinDepth && !cache.stack[ply - 1].isNullMove && !is_mate_score(beta) && staticEval >= beta && !isInCheck && has_non_pawn_material(board, board.isWhitesTurn))
+    {
+      const size_t reducedDepth = depth - 1 - lsMin(depth - 1, null_move_reduction(depth));
+
+      stackEntry.isNullMove = true;
+      stackEntry.currentMove = chess_move();
+      stackEntry.movedPiece = cpT_none;
+      cache.stack[ply + 1].extensions = stackEntry.extensions;
+      int32_t score = -alpha_beta_step(perform_null_move(board), -beta, -beta + 1, reducedDepth, ply + 1, cache);
+      stackEntry.isNullMove = false;
+
+      if (cache.isStopped)
+        return 0;
+
+      if (score >= beta)
+      {
+        if (score >= MinMateScore) // a king capture after passing isn't proven.
+          score = beta;
+
+        if (depth < NullMoveVerificationMinDepth)
+          return score;
+
+        // Verify by searching this node at the reduced depth without null moves for the side to move.
+        const size_t previousNullMoveMinPly = cache.nullMoveMinPly;
+        cache.nullMoveMinPly = ply + 3 * reducedDepth / 4 + 1;
+        const int32_t verification = alpha_beta_step(board, beta - 1, beta, reducedDepth, ply, cache);
+        cache.nullMoveMinPly = previousNullMoveMinPly;
+
+        if (cache.isStopped)
+          return 0;
+
+        if (verification >= beta)
+          return score;
+      }
+    }
+  }
+
+  // Extensions must not exceed the stack, and are limited to a quarter of the iteration depth along each line, as long forcing sequences would otherwise blow up the search.
+  const bool canExtend = ply + depth < MaxSearchDepth && stackEntry.extensions < cache.rootDepth / 4;
+
+  // Singular extension: if the move from the transposition table is better than all others by a margin, the position hinges on it, so it's searched one ply deeper.
+  // The others are searched at a reduced depth with a null window below the score of the entry, while the entry move is excluded.
+  // As that search happens at this ply, it has to be done before the moves of this ply are generated.
+  bool isEntryMoveSingular = false;
+
+  if constexpr (UseSingularExtensions)
+  {
+    if (ply > 0 && canExtend && !isExclusionSearch && depth >= SingularExtensionMinDepth && entryMatches && entryBound != ttb_upper && entryDepth + SingularExtensionMaxEntryDepthDifference >= depth && !is_mate_score(entryScore))
+    {
+      const int32_t singularBeta = entryScore - SingularExtensionMargin * (int32_t)depth;
+
+      stackEntry.excludedMove = entryMove;
+      stackEntry.hasExcludedMove = true;
+      const int32_t score = alpha_beta_step(board, singularBeta - 1, singularBeta, (depth - 1) / 2, ply, cache);
+      stackEntry.hasExcludedMove = false;
+
+      if (cache.isStopped)
+        return 0;
+
+      isEntryMoveSingular = score < singularBeta;
+    }
+  }
+
+  list<chess_move> &moves = stackEntry.moves;
+  LS_DEBUG_ERROR_ASSERT(get_all_valid_ordered_moves(moves, board, cache.pieceMoves[0], cache.pieceMovesWithNonCapture));
+  alpha_beta_order_moves(cache, board, ply);
+
+  int32_t bestScore = -InfiniteScore;
+
+  // Try the best move of a previous search of this position first.
+  if (entryMatches)
+  {
+    for (size_t i = 1; i < moves.count; i++)
+    {
+      if (moves[i] == entryMove)
+      {
+        const chess_move move = moves[i];
+        lsMemmove(moves.pValues + 1, moves.pValues, i);
+        moves[0] = move;
+        break;
+      }
+    }
+  }
+
+  // Lazy SMP helper threads try the root moves after the first one in a different order, so they don't all search the same subtrees at the same time.
+  if (ply == 0 && cache.threadIndex > 0 && !cache.deferSearchingPositions && moves.count > 2)
+  {
+    const size_t shift = cache.threadIndex % (moves.count - 1);
+
+    for (size_t i = 0; i < shift; i++)
+    {
+      const chess_move move = moves[1];
+      lsMemmove(moves.pValues + 1, moves.pValues + 2, moves.count - 2);
+      moves[moves.count - 1] = move;
+    }
+  }
+
+  stackEntry.bestMove = moves.count ? moves[0] : chess_move();
+  cache.pvLength[ply] = ply; // the pruning searches above may have left a line of their own.
+
+  // moves deferred by ABDADA are searched after all others, keeping their index in the move ordering.
+  uint8_t deferredMoveIndices[MaxOrderedMoves];
+  size_t deferredMoveCount = 0;
+
+  uint8_t searchedQuietMoveIndices[MaxOrderedMoves];
+  size_t searchedQuietMoveCount = 0;
+
+  for (size_t loopIndex = 0; loopIndex < moves.count + deferredMoveCount; loopIndex++)
+  {
+    const bool isDeferred = loopIndex >= moves.count;
+    const size_t moveIndex = isDeferred ? deferredMoveIndices[loopIndex - moves.count] : loopIndex;
+
+    // Once the first root move is searched, the threads of a root split take over the others.
+    if (ply == 0 && cache.pRootSplit != nullptr && bestScore != -InfiniteScore)
+    {
+      bestScore = alpha_beta_root_split(board, alpha, beta, depth, moveIndex, bestScore, isInCheck, isPvNode, canExtend, cache);
+
+      if (cache.isStopped)
+        return 0;
+
+      if (bestScore == InfiniteScore) // Found move from opening book.
+        return InfiniteScore;
+
+      break;
+    }
+
+    const chess_move move = moves[moveIndex];
+
+    if (stackEntry.hasExcludedMove && stackEntry.excludedMove == move)
+      continue;
+
+    if (ply == 0 && alpha_beta_is_root_move_excluded(cache, move))
+      continue;
 
-      const moves_with_score<CacheDepth> moveRating = alpha_beta_step<!FindMin, MaxDepth, CacheDepth, DepthIndex + 1>(after, alpha, beta, cache);
+    const bool isQuiet = is_quiet_move(board, move);
 
 #ifdef _DEBUG
-      cache.stepMin[CacheDepthIndex] = lsMin(moveRating.score, cache.stepMin[CacheDepthIndex]);
-      cache.stepMax[CacheDepthIndex] = lsMax(moveRating.score, cache.stepMax[CacheDepthIndex]);
+    cache.nodesVisited++;
 #endif
 
-      if constexpr (FindMin)
-      {
-        if (moveRating.score < ret.score)
-        {
-          ret = moveRating;
+    const chess_board after = perform_move(board, move);
+    stackEntry.currentMove = move;
+    stackEntry.movedPiece = board[vec2i8(move.startX, move.startY)].piece;
 
-          if (ret.score < beta)
-            beta = ret.score;
+    if (ply == 0 && micro_starting_board_find(after, pStartingBoardHashMap, StartingBoardHashCount))
+    {
+      stackEntry.bestMove = move;
+      cache.pvLength[ply + 1] = ply + 1;
+      alpha_beta_update_pv(cache, ply, move);
+      return InfiniteScore;
+    }
 
-          if (ret.score <= alpha)
-            break;
-        }
+    const bool givesCheck = is_in_check(after);
+
+    if (canPruneShallow && moveIndex > 0 && isQuiet && !givesCheck)
+    {
+      // Late move pruning: late quiet moves at shallow depths are very unlikely to cause a cutoff.
+      if (depth <= LateMovePruningMaxDepth && moveIndex >= late_move_pruning_move_count(depth))
+        continue;
+
+      // Futility pruning: quiet moves can't raise alpha if the static evaluation is too far below it.
+      if (depth <= FutilityMaxDepth && staticEval + FutilityMargin[depth] <= alpha)
+        continue;
+    }
+
+    // Check extension: checks are forcing, so their consequences are searched one ply deeper instead of ending the search in the middle of the sequence.
+    // Checks that just lose the checking piece aren't forcing anything, so they aren't extended.
+    size_t extension = 0;
+
+    if (canExtend && ((UseCheckExtensions && givesCheck && static_exchange_evaluation(board, move) >= 0) || (isEntryMoveSingular && moveIndex == 0 && move == entryMove)))
+      extension = 1;
+
+    const size_t childDepth = depth - 1 + extension;
+    const bool isSearchingPositionMarked = cache.deferSearchingPositions && childDepth >= AbdadaMinDepth;
+
+    if (isSearchingPositionMarked)
+    {
+      if (!isDeferred && bestScore != -InfiniteScore && searching_positions_contains(after.hash))
+      {
+        lsAssert(moves.count <= MaxOrderedMoves);
+        deferredMoveIndices[deferredMoveCount++] = (uint8_t)moveIndex;
+        continue;
       }
-      else
+
+      searching_positions_add(after.hash);
+    }
+
+    cache.stack[ply + 1].extensions = stackEntry.extensions + extension;
+
+    // Principal variation search: Only the first move is searched with the full window.
+    const int32_t score = moveIndex == 0 ? -alpha_beta_step(after, -beta, -alpha, childDepth, ply + 1, cache) : alpha_beta_search_later_move(board, after, move, moveIndex, alpha, beta, depth, childDepth, ply, isInCheck, isPvNode, givesCheck, isQuiet, cache);
+
+    if (isSearchingPositionMarked)
+      searching_positions_remove(after.hash);
+
+    // The score of an aborted subtree is meaningless, so it must neither be used nor stored.
+    if (cache.isStopped)
+      return 0;
+
+#ifdef _DEBUG
+    cache.stepMin[ply] = lsMin(score, cache.stepMin[ply]);
+    cache.stepMax[ply] = lsMax(score, cache.stepMax[ply]);
+#endif
+
+    if (score > bestScore)
+    {
+      bestScore = score;
+      stackEntry.bestMove = move;
+
+      if (bestScore > alpha)
       {
-        if (moveRating.score > ret.score)
-        {
-          ret = moveRating;
+        alpha = bestScore;
+        alpha_beta_update_pv(cache, ply, move);
+      }
 
-          if (ret.score > alpha)
-            alpha = ret.score;
+      if (bestScore >= beta)
+      {
+        if (isQuiet)
+          alpha_beta_record_quiet_cutoff(cache, board, ply, depth, moveIndex, searchedQuietMoveIndices, searchedQuietMoveCount);
 
-          if (ret.score >= beta)
-            break;
-        }
+        break;
       }
     }
 
-    const int64_t end = __rdtsc();
-    cache.ticksPerLayer[CacheDepthIndex] += end - begin;
+    if (isQuiet)
+      searchedQuietMoveIndices[searchedQuietMoveCount++] = (uint8_t)moveIndex;
+  }
+
+  if (moves.count && !isExclusionSearch)
+  {
+    const transposition_table_bound bound = bestScore <= alphaOriginal ? ttb_upper : (bestScore >= beta ? ttb_lower : ttb_exact);
+    transposition_table_store(cache.transpositionTableStats, pSlot, hash, bestScore, bound, stackEntry.bestMove, depth, ply);
+  }
+
+  const int64_t end = __rdtsc();
+  cache.ticksPerLayer[ply] += end - begin;
+
+  return bestScore;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+constexpr size_t DefaultMinimaxDepth = 4;
+
+chess_move get_minimax_move_white(const chess_board &board)
+{
+  const move_with_score moveInfo = minimax_step<DefaultMinimaxDepth, true>(board);
+  return moveInfo.move;
+}
+
+chess_move get_minimax_move_black(const chess_board &board)
+{
+  const move_with_score moveInfo = minimax_step<DefaultMinimaxDepth, false>(board);
+  return moveInfo.move;
+}
+
+// Shared by all parallel searches, as creating threads for every search would take longer than short searches themselves.
+// Searches take turns using it (and the caches of the search threads), as they'd otherwise await each other's tasks (or destroy the pool while it's in use to grow it).
+static thread_pool *_pSearchThreadPool = nullptr;
+static std::mutex _SearchThreadPoolMutex;
+
+// Must only be called while holding `_SearchThreadPoolMutex`.
+thread_pool *search_thread_pool_get(const size_t threadCount)
+{
+  if (_pSearchThreadPool != nullptr && thread_pool_thread_count(_pSearchThreadPool) < threadCount)
+    thread_pool_destroy(&_pSearchThreadPool);
+
+  if (_pSearchThreadPool == nullptr)
+    _pSearchThreadPool = thread_pool_new(threadCount);
 
-    return ret;
-  }
+  return _pSearchThreadPool;
 }
 
-//////////////////////////////////////////////////////////////////////////
+// The caches of the search threads, indexed by thread index, are kept across searches, as creating them for every search takes a lot longer than short searches would, and their pawn hash tables and evaluation caches still hit in the positions of the next move. The main thread of every search, parallel or not, uses the one of thread 0.
+static alpha_beta_minimax_cache *_pSearchThreadCaches[MaxSearchThreads] = {};
 
-constexpr size_t DefaultMinimaxDepth = 4;
+// Must only be called while holding `_SearchThreadPoolMutex`. The cache still needs to be reset for the search.
+alpha_beta_minimax_cache *search_thread_cache_get(const size_t threadIndex)
+{
+  lsAssert(threadIndex < MaxSearchThreads);
 
-chess_move get_minimax_move_white(const chess_board &board)
+  if (_pSearchThreadCaches[threadIndex] == nullptr)
+  {
+    _pSearchThreadCaches[threadIndex] = new alpha_beta_minimax_cache();
+    LS_DEBUG_ERROR_ASSERT(alpha_beta_minimax_cache_create(*_pSearchThreadCaches[threadIndex]));
+  }
+
+  return _pSearchThreadCaches[threadIndex];
+}
+
+void search_thread_pool_destroy()
 {
-  const move_with_score moveInfo = minimax_step<DefaultMinimaxDepth, true>(board);
-  return moveInfo.move;
+  std::lock_guard<std::mutex> lock(_SearchThreadPoolMutex);
+  thread_pool_destroy(&_pSearchThreadPool);
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(_pSearchThreadCaches); i++)
+  {
+    delete _pSearchThreadCaches[i];
+    _pSearchThreadCaches[i] = nullptr;
+  }
 }
 
-chess_move get_minimax_move_black(const chess_board &board)
+void search_caches_clear()
 {
-  const move_with_score moveInfo = minimax_step<DefaultMinimaxDepth, false>(board);
-  return moveInfo.move;
+  std::lock_guard<std::mutex> lock(_SearchThreadPoolMutex);
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(_pSearchThreadCaches); i++)
+    if (_pSearchThreadCaches[i] != nullptr)
+      alpha_beta_minimax_cache_clear(*_pSearchThreadCaches[i]);
 }
 
 template <bool IsWhite>
-chess_move get_alpha_beta_move(const chess_board &board)
+chess_move get_alpha_beta_move(const chess_board &board, const chess_history *pHistory)
 {
-  constexpr size_t Depth = 6;
+  lsAssert(!!board.isWhitesTurn == IsWhite);
+
+  const size_t depth = DefaultSearchDepth;
 
 #ifdef _DEBUG
   const int64_t before = lsGetCurrentTimeNs();
 #endif
 
-  alpha_beta_minimax_cache<Depth> cache;
-  LS_DEBUG_ERROR_ASSERT(alpha_beta_minimax_cache_create(cache));
+  const transposition_table_stats transpositionTableStatsBefore = transposition_table_get_stats();
+
+  std::lock_guard<std::mutex> threadPoolLock(_SearchThreadPoolMutex);
 
-  const moves_with_score<Depth> moveInfo = alpha_beta_step<!IsWhite, Depth>(board, score_with_depth(lsMinValue<int64_t>(), Depth + cache.MaxQuiescenceDepth), score_with_depth(lsMaxValue<int64_t>(), Depth + cache.MaxQuiescenceDepth), cache);
+  alpha_beta_minimax_cache &cache = *search_thread_cache_get(0);
+  alpha_beta_minimax_cache_reset(cache);
+  alpha_beta_minimax_cache_set_history(cache, board, pHistory);
+
+  const int32_t score = alpha_beta_step(board, -InfiniteScore, InfiniteScore, depth, 0, cache);
+  const chess_move bestMove = cache.stack[0].bestMove;
+  transposition_table_stats_add(cache.pTranspositionTable->stats, cache.transpositionTableStats);
 
 #ifdef _DEBUG
   const int64_t after = lsGetCurrentTimeNs();
 
   print(FU(Group)(cache.nodesVisited), " + ", FU(Group)(cache.quiescenceNodesVisited), " nodes visited (in ", FF(Max(5))((after - before) * 1e-9f), "s, ", FF(Max(9), Group)((cache.nodesVisited + cache.quiescenceNodesVisited) / ((after - before) * 1e-9f)), "/s)\n");
+  print("Pawn hash table: ", FU(Group)(cache.pawnHashTable.hits), " hits, ", FU(Group)(cache.pawnHashTable.misses), " misses (", FF(Max(5))((cache.pawnHashTable.hits * 100.f) / lsMax((size_t)1, cache.pawnHashTable.hits + cache.pawnHashTable.misses)), "% hit rate)\n");
 
-  print("\nBest Moves (rating: ", moveInfo.score.score, " at depth: ", moveInfo.score.depth, "):\n");
-
-  for (size_t i = 0; i < Depth; i++)
-  {
-    print_move(moveInfo.moves[i]);
-    print(", ");
-  }
+  print("\nBest Move (rating: ", score, "): ");
+  print_move(bestMove);
 
-  print("\nBest move combination for white (rating: ", cache.highestScore.score, " at depth: ", cache.highestScore.depth, "):\n");
+  print("\nBest move combination for white (rating: ", cache.highestScore, "):\n");
 
-  for (size_t i = 0; i < Depth; i++)
+  for (size_t i = 0; i < cache.highestMoveCount; i++)
   {
     print_move(cache.highestMove[i]);
     print(", ");
   }
 
-  print("\nBest move combination for black (rating: ", cache.lowestScore.score, " at depth: ", cache.lowestScore.depth, "):\n");
+  print("\nBest move combination for black (rating: ", cache.lowestScore, "):\n");
 
-  for (size_t i = 0; i < Depth; i++)
+  for (size_t i = 0; i < cache.lowestMoveCount; i++)
   {
     print_move(cache.lowestMove[i]);
     print(", ");
@@ -1733,136 +3744,381 @@ chess_move get_alpha_beta_move(const chess_board &board)
 
   print("\nRating Distribution:\n");
 
-  for (size_t i = 0; i < Depth; i++)
-    print(cache.stepMin[i].score, " ~ ", cache.stepMax[i].score, ", ");
+  for (size_t i = 0; i < depth; i++)
+    print(cache.stepMin[i], " ~ ", cache.stepMax[i], ", ");
 
   print('\n');
+#else
+  (void)score;
 #endif
 
-  print("\nTotal ticks: 100% (", FI(Group)(cache.ticksPerLayer[0]), ")\n");
+  print('\n');
+  transposition_table_print_stats(transpositionTableStatsBefore);
+  print("Evaluation cache: ", FU(Group)(cache.evaluationCache.hits), " hits, ", FU(Group)(cache.evaluationCache.misses), " misses (", FF(Max(5))((cache.evaluationCache.hits * 100.f) / lsMax((size_t)1, cache.evaluationCache.hits + cache.evaluationCache.misses)), "% hit rate)\n");
+  print("Total ticks: 100% (", FI(Group)(cache.ticksPerLayer[0]), ")\n");
 
-  for (size_t i = 0; i < LS_ARRAYSIZE(cache.ticksPerLayer) - 1; i++)
+  for (size_t i = 0; i < depth; i++)
   {
     const int64_t ticks = cache.ticksPerLayer[i] - cache.ticksPerLayer[i + 1];
     print("Layer ", i, ": ", FF(Min(8), Max(8))((ticks * 100.f) / cache.ticksPerLayer[0]), "% (", FI(Group)(ticks), ")\n");
   }
 
-  print("Layer ", Depth, ": ", FF(Min(8), Max(8))((cache.ticksPerLayer[Depth] * 100.f) / cache.ticksPerLayer[0]), "% (", FI(Group)(cache.ticksPerLayer[Depth]), ")\n");
+  print("Layer ", depth, ": ", FF(Min(8), Max(8))((cache.ticksPerLayer[depth] * 100.f) / cache.ticksPerLayer[0]), "% (", FI(Group)(cache.ticksPerLayer[depth]), ")\n");
 
   print('\n');
 
-  return moveInfo.moves[0];
+  return bestMove;
 }
 
-chess_move get_alpha_beta_move_white(const chess_board &board)
+chess_move get_alpha_beta_move_white(const chess_board &board, const chess_history *pHistory)
 {
-  return get_alpha_beta_move<true>(board);
+  return get_alpha_beta_move<true>(board, pHistory);
 }
 
-chess_move get_alpha_beta_move_black(const chess_board &board)
+chess_move get_alpha_beta_move_black(const chess_board &board, const chess_history *pHistory)
 {
-  return get_alpha_beta_move<false>(board);
+  return get_alpha_beta_move<false>(board, pHistory);
 }
 
 //////////////////////////////////////////////////////////////////////////
 
-template <bool FindMin, size_t CacheDepth, size_t Depth>
-moves_with_score<CacheDepth> alpha_beta_aspiration(const chess_board &board, const score_with_depth guess, alpha_beta_minimax_cache<CacheDepth> &cache)
+constexpr int32_t AspirationInitialDelta = 25;
+constexpr int32_t AspirationMaxDelta = 1000; // beyond this, the window is opened completely.
+
+// Searches a window around the score of the previous iteration. Whenever the score falls outside of it, the window is re-centred on the returned bound and widened, so unstable positions don't need a full window right away.
+int32_t alpha_beta_aspiration(const chess_board &board, const int32_t guess, const size_t depth, alpha_beta_minimax_cache &cache)
 {
-  constexpr int64_t delta = 50;
-  const score_with_depth alpha = score_with_depth(guess.score - delta, guess.depth);
-  const score_with_depth beta = score_with_depth(guess.score + delta, guess.depth);
+  int32_t delta = AspirationInitialDelta;
+  int32_t alpha = is_mate_score(guess) ? -InfiniteScore : guess - delta;
+  int32_t beta = is_mate_score(guess) ? InfiniteScore : guess + delta;
 
-  moves_with_score<CacheDepth> ret = alpha_beta_step<FindMin, Depth>(board, alpha, beta, cache);
+  while (true)
+  {
+    const int32_t score = alpha_beta_step(board, alpha, beta, depth, 0, cache);
 
-  print("\taspiration: ", Depth, " / ", CacheDepth, ": ", ret.score.score, " (", alpha.score, " ~ ", beta.score, ")");
+    if (cache.isStopped || (score > alpha && score < beta))
+      return score;
 
-  if (ret.score <= alpha)
-    ret = alpha_beta_step<FindMin, Depth>(board, score_with_depth(lsMinValue<int64_t>(), CacheDepth + cache.MaxQuiescenceDepth), beta, cache);
-  else if (ret.score >= beta)
-    ret = alpha_beta_step<FindMin, Depth>(board, alpha, score_with_depth(lsMaxValue<int64_t>(), CacheDepth + cache.MaxQuiescenceDepth), cache);
+    // the window can't be widened any further, which happens if there are no moves to search (or a move from the opening book is found).
+    if ((score <= alpha && alpha == -InfiniteScore) || (score >= beta && beta == InfiniteScore))
+      return score;
 
-  print(" => ", ret.score.score, '\n');
+    if (score <= alpha)
+      cache.aspirationFailLows++;
+    else
+      cache.aspirationFailHighs++;
 
-  return ret;
+    delta *= 2;
+
+    if (delta > AspirationMaxDelta || is_mate_score(score))
+    {
+      alpha = score <= alpha ? -InfiniteScore : alpha;
+      beta = score >= beta ? InfiniteScore : beta;
+    }
+    else
+    {
+      alpha = lsMax(score - delta, -InfiniteScore);
+      beta = lsMin(score + delta, InfiniteScore);
+    }
+  }
 }
 
-template <bool FindMin, size_t CacheDepth, size_t Depth = 1>
-void alpha_beta_iterative_deepen(const chess_board &board, alpha_beta_minimax_cache<CacheDepth> &cache, moves_with_score<CacheDepth> &ret)
+// Searches the root once per line. Each search skips the root moves of the lines before, so every line is the best one apart from those. All of them share the transposition table.
+// Returns the number of lines found, which may be less than requested if the root runs out of moves. If the search was stopped, only the lines before that are complete.
+size_t alpha_beta_search_root_lines(const chess_board &board, const size_t depth, const size_t lineCount, alpha_beta_minimax_cache &cache, _Out_ search_line *pLines)
 {
-  static_assert(Depth > 0);
+  size_t count = 0;
+  cache.rootExcludedMoveCount = 0;
 
-  if constexpr (Depth == 1)
+  while (count < lineCount)
   {
-    ret = alpha_beta_step<FindMin, Depth>(board, score_with_depth(lsMinValue<int64_t>(), CacheDepth + cache.MaxQuiescenceDepth), score_with_depth(lsMaxValue<int64_t>(), CacheDepth + cache.MaxQuiescenceDepth), cache);
+    // lines the previous iteration found as well are expected to score about the same.
+    int32_t score;
+
+    if (count < cache.rootLineCount)
+      score = alpha_beta_aspiration(board, cache.rootLines[count].score, depth, cache);
+    else
+      score = alpha_beta_step(board, -InfiniteScore, InfiniteScore, depth, 0, cache);
+
+    if (cache.isStopped || score == -InfiniteScore) // stopped or out of root moves.
+      break;
+
+    search_line &line = pLines[count];
+    line.score = score;
+    line.pvLength = cache.pvLength[0];
 
-    print("\titerative deepen: ", Depth, " / ", CacheDepth, ": ", ret.score.score, '\n');
+    for (size_t i = 0; i < line.pvLength; i++)
+      line.pv[i] = cache.pv[0][i];
 
-    if (ret.score.score == lsMaxValue<int64_t>()) // Found move from opening book.
+    // if the root failed low, there is no line, but still a best move.
+    if (line.pvLength == 0)
     {
-      lsMemmove(ret.moves, ret.moves + CacheDepth - (Depth - 1), 1);
-      return;
+      line.pv[0] = cache.stack[0].bestMove;
+      line.pvLength = 1;
     }
 
-    if constexpr (CacheDepth > Depth)
-      alpha_beta_iterative_deepen<FindMin, CacheDepth, Depth + 1>(board, cache, ret);
+    count++;
+    cache.rootExcludedMoves[cache.rootExcludedMoveCount++] = line.pv[0];
+
+    if (score == InfiniteScore) // Found move from opening book, no need to look for others.
+      break;
   }
-  else
+
+  cache.rootExcludedMoveCount = 0;
+
+  return count;
+}
+
+void print_search_line(const search_line &line)
+{
+  print(line.score, ", pv:");
+
+  for (size_t i = 0; i < line.pvLength; i++)
+  {
+    print(' ');
+    print_move(line.pv[i]);
+  }
+
+  print('\n');
+}
+
+// Returns the score of the best line of the last completed iteration, whose lines are kept in `cache.rootLines`. If not even the first one completes, `pBestMove` is the best move found so far (or the first one in move ordering).
+int32_t alpha_beta_iterative_deepen(const chess_board &board, const search_limits &limits, alpha_beta_minimax_cache &cache, _Out_ chess_move *pBestMove)
+{
+  lsAssert(limits.maxDepth > 0 && limits.maxDepth <= MaxSearchDepth);
+
+  const size_t lineCount = lsClamp(limits.multiPv, (size_t)1, MaxMultiPv);
+  search_line lines[MaxMultiPv];
+
+  cache.rootLineCount = 0;
+  cache.rootLinesDepth = 0;
+
+  const bool isMainThread = cache.threadIndex == 0;
+
+  // Every other Lazy SMP helper thread stays one ply ahead of the main thread, so their results are available by the time the main thread gets there. ABDADA threads have to search the same iteration to split its work.
+  const size_t firstDepth = cache.deferSearchingPositions ? 1 : lsMin(1 + (cache.threadIndex & 1), limits.maxDepth);
+
+  for (size_t depth = firstDepth; depth <= limits.maxDepth; depth++)
   {
-    if (lsAbs(ret.score.score) >= PieceScores[cpT_king] && ret.score.depth <= Depth)
+    if (cache.rootLineCount > 0)
     {
-      lsMemmove(ret.moves, ret.moves + CacheDepth - (Depth - 1), 1);
-      return;
+      if (is_mate_score(cache.rootLines[0].score)) // A king capture (or a move from the opening book) has been found, searching deeper won't change that.
+        break;
+
+      // An iteration takes a multiple of the time of the previous one, so there's no point in starting one that's bound to be aborted.
+      if (limits.softDeadlineNs != 0 && lsGetCurrentTimeNs() >= limits.softDeadlineNs)
+        break;
+    }
+
+    const size_t count = alpha_beta_search_root_lines(board, depth, lineCount, cache, lines);
+
+    if (cache.isStopped || count == 0)
+    {
+      if (cache.rootLineCount == 0)
+        *pBestMove = count > 0 ? lines[0].pv[0] : cache.stack[0].bestMove;
+
+      if (cache.isStopped && isMainThread)
+        print("\tstopped at depth ", depth, " after ", FU(Group)(cache.nodes), " nodes.\n");
+
+      break;
     }
 
-    ret = alpha_beta_aspiration<FindMin, CacheDepth, Depth>(board, ret.score, cache);
+    for (size_t i = 0; i < count; i++)
+      cache.rootLines[i] = lines[i];
+
+    cache.rootLineCount = count;
+    cache.rootLinesDepth = depth;
+    *pBestMove = lines[0].pv[0];
+
+    for (size_t i = 0; i < count && isMainThread; i++)
+    {
+      print("\titerative deepen: ", depth, " / ", limits.maxDepth, ": ");
+
+      if (lineCount > 1)
+        print("line ", i + 1, ": ");
 
-    if constexpr (CacheDepth > Depth)
-      alpha_beta_iterative_deepen<FindMin, CacheDepth, Depth + 1>(board, cache, ret);
+      print_search_line(lines[i]);
+    }
   }
+
+  if (isMainThread)
+    print("\taspiration window failed ", cache.aspirationFailHighs, "x high, ", cache.aspirationFailLows, "x low.\n");
+
+  return cache.rootLineCount > 0 ? cache.rootLines[0].score : 0;
 }
 
 //////////////////////////////////////////////////////////////////////////
 
+void alpha_beta_get_result(const alpha_beta_minimax_cache &cache, const int32_t score, const chess_move bestMove, _Out_ search_result *pResult)
+{
+  pResult->depth = cache.rootLinesDepth;
+  pResult->nodes = cache.nodes;
+  pResult->lineCount = cache.rootLineCount;
+
+  for (size_t i = 0; i < cache.rootLineCount; i++)
+    pResult->lines[i] = cache.rootLines[i];
+
+  // not even the first iteration completed.
+  if (pResult->lineCount == 0)
+  {
+    pResult->lines[0].score = score;
+    pResult->lines[0].pv[0] = bestMove;
+    pResult->lines[0].pvLength = 1;
+    pResult->lineCount = 1;
+  }
+}
+
+// Runs on a thread of the search thread pool until `pStop` is set. Its transposition table entries (and with ABDADA, the subtrees it takes off the main thread) are what speeds up the main thread.
+void alpha_beta_helper_search(const chess_board &board, const chess_history *pHistory, const search_limits &limits, alpha_beta_minimax_cache &cache, const size_t threadIndex, std::atomic<bool> *pStop, _Out_ search_result *pResult, _Out_ transposition_table_stats *pTranspositionTableStats)
+{
+  alpha_beta_minimax_cache_reset(cache);
+  alpha_beta_minimax_cache_set_history(cache, board, pHistory);
+
+  cache.threadIndex = threadIndex;
+  cache.deferSearchingPositions = limits.parallelMode == spm_abdada;
+  cache.pStop = pStop;
+
+  search_limits helperLimits;
+  helperLimits.maxDepth = limits.maxDepth;
+
+  chess_move bestMove;
+  const int32_t score = alpha_beta_iterative_deepen(board, helperLimits, cache, &bestMove);
+
+  alpha_beta_get_result(cache, score, bestMove, pResult);
+  *pTranspositionTableStats = cache.transpositionTableStats;
+}
+
 template <bool IsWhite>
-chess_move get_complex_move(const chess_board &board)
+chess_move get_complex_move(const chess_board &board, const chess_history *pHistory, const search_limits *pLimits, _Out_opt_ search_result *pResult)
 {
-  constexpr size_t Depth = 6;
+  lsAssert(!!board.isWhitesTurn == IsWhite);
 
-#ifdef _DEBUG
   const int64_t before = lsGetCurrentTimeNs();
-#endif
 
-  alpha_beta_minimax_cache<Depth> cache;
-  LS_DEBUG_ERROR_ASSERT(alpha_beta_minimax_cache_create(cache));
+  search_limits limits = pLimits != nullptr ? *pLimits : search_limits();
+  limits.maxDepth = lsClamp(limits.maxDepth, (size_t)1, MaxSearchDepth);
 
-  moves_with_score<Depth> moveInfo;
-  alpha_beta_iterative_deepen<!IsWhite>(board, cache, moveInfo);
+  if (limits.maxTimeMs != 0)
+  {
+    if (limits.softDeadlineNs == 0)
+      limits.softDeadlineNs = before + limits.maxTimeMs * 1000 * 1000 / 2;
 
-#ifdef _DEBUG
-  const int64_t after = lsGetCurrentTimeNs();
+    if (limits.hardDeadlineNs == 0)
+      limits.hardDeadlineNs = before + limits.maxTimeMs * 1000 * 1000;
+  }
 
-  print(FU(Group)(cache.nodesVisited), " + ", FU(Group)(cache.quiescenceNodesVisited), " nodes visited (in ", FF(Max(5))((after - before) * 1e-9f), "s, ", FF(Max(9), Group)((cache.nodesVisited + cache.quiescenceNodesVisited) / ((after - before) * 1e-9f)), "/s)\n");
+  const size_t depth = limits.maxDepth;
+
+  std::lock_guard<std::mutex> threadPoolLock(_SearchThreadPoolMutex);
+
+  alpha_beta_minimax_cache &cache = *search_thread_cache_get(0);
+  alpha_beta_minimax_cache_reset(cache);
+  alpha_beta_minimax_cache_set_history(cache, board, pHistory);
+
+  cache.maxNodes = limits.maxNodes;
+  cache.hardDeadlineNs = limits.hardDeadlineNs;
+  cache.pStop = limits.pStop;
 
-  print("\nBest Moves (rating: ", moveInfo.score.score, "):\n");
+  // Lazy SMP & ABDADA helpers can't count against a node budget, as they don't split the work, so node limited searches (like those of skill levels) run on a single thread in these modes.
+  const size_t threadCount = (limits.maxNodes != 0 && limits.parallelMode != spm_root_split) ? 1 : lsClamp(limits.threads, (size_t)1, MaxSearchThreads);
 
-  for (size_t i = 0; i < Depth; i++)
+  root_split split;
+
+  if (threadCount > 1 && limits.parallelMode == spm_root_split)
   {
-    print_move(moveInfo.moves[i]);
-    print(", ");
+    split.pThreadPool = search_thread_pool_get(threadCount - 1);
+    cache.pRootSplit = &split;
+    cache.pSplitStop = &split.stop;
+
+    for (size_t i = 1; i < threadCount; i++)
+    {
+      alpha_beta_minimax_cache *pWorkerCache = search_thread_cache_get(i);
+      split.pWorkerCaches[split.workerCount++] = pWorkerCache;
+
+      alpha_beta_minimax_cache_reset(*pWorkerCache);
+      alpha_beta_minimax_cache_set_history(*pWorkerCache, board, pHistory);
+
+      pWorkerCache->threadIndex = i;
+      pWorkerCache->hardDeadlineNs = limits.hardDeadlineNs;
+      pWorkerCache->pStop = limits.pStop;
+      pWorkerCache->pSplitStop = &split.stop;
+    }
+  }
+
+  // Lazy SMP & ABDADA: the helper threads run the same search on the shared transposition table until the main thread is done. They only need to be started once the main cache (and with it the transposition table) exists.
+  const bool hasHelperThreads = threadCount > 1 && (limits.parallelMode == spm_lazy_smp || limits.parallelMode == spm_abdada);
+  thread_pool *pThreadPool = hasHelperThreads ? search_thread_pool_get(threadCount - 1) : nullptr;
+  cache.deferSearchingPositions = hasHelperThreads && limits.parallelMode == spm_abdada;
+  std::atomic<bool> helperStop = false;
+  search_result helperResults[MaxSearchThreads - 1];
+  transposition_table_stats helperTranspositionTableStats[MaxSearchThreads - 1];
+
+  for (size_t i = 1; i < threadCount && pThreadPool != nullptr; i++)
+  {
+    alpha_beta_minimax_cache *pHelperCache = search_thread_cache_get(i);
+    thread_pool_add(pThreadPool, [&, i, pHelperCache]() { alpha_beta_helper_search(board, pHistory, limits, *pHelperCache, i, &helperStop, &helperResults[i - 1], &helperTranspositionTableStats[i - 1]); });
+  }
+
+  chess_move bestMove;
+  int32_t score = alpha_beta_iterative_deepen(board, limits, cache, &bestMove);
+
+  search_result result;
+  alpha_beta_get_result(cache, score, bestMove, &result);
+
+  if (pThreadPool != nullptr)
+  {
+    helperStop = true;
+    thread_pool_await(pThreadPool);
+
+    // The result of the main thread is used, unless a helper completed a deeper iteration with a better score. Helpers only search one line, so they can't replace multiple ones.
+    size_t totalNodes = result.nodes;
+    const search_result *pBest = &result;
+
+    for (size_t i = 0; i < threadCount - 1; i++)
+    {
+      totalNodes += helperResults[i].nodes;
+      transposition_table_stats_add(cache.transpositionTableStats, helperTranspositionTableStats[i]);
+
+      if (result.lineCount == 1 && helperResults[i].depth > pBest->depth && helperResults[i].lines[0].score > pBest->lines[0].score)
+        pBest = &helperResults[i];
+    }
+
+    if (pBest != &result)
+    {
+      result = *pBest;
+      score = result.lines[0].score;
+      bestMove = result.lines[0].pv[0];
+    }
+
+    result.nodes = totalNodes;
   }
 
-  print("\nBest move combination for white (rating: ", cache.highestScore.score, " at depth: ", cache.highestScore.depth, "):\n");
+  transposition_table_stats_add(cache.pTranspositionTable->stats, cache.transpositionTableStats);
+
+  if (pResult != nullptr)
+    *pResult = result;
+
+#ifdef _DEBUG
+  const int64_t after = lsGetCurrentTimeNs();
+
+  print(FU(Group)(cache.nodesVisited), " + ", FU(Group)(cache.quiescenceNodesVisited), " nodes visited (in ", FF(Max(5))((after - before) * 1e-9f), "s, ", FF(Max(9), Group)((cache.nodesVisited + cache.quiescenceNodesVisited) / ((after - before) * 1e-9f)), "/s)\n");
+  print("Pawn hash table: ", FU(Group)(cache.pawnHashTable.hits), " hits, ", FU(Group)(cache.pawnHashTable.misses), " misses (", FF(Max(5))((cache.pawnHashTable.hits * 100.f) / lsMax((size_t)1, cache.pawnHashTable.hits + cache.pawnHashTable.misses)), "% hit rate)\n");
+  print("Evaluation cache: ", FU(Group)(cache.evaluationCache.hits), " hits, ", FU(Group)(cache.evaluationCache.misses), " misses (", FF(Max(5))((cache.evaluationCache.hits * 100.f) / lsMax((size_t)1, cache.evaluationCache.hits + cache.evaluationCache.misses)), "% hit rate)\n");
+
+  print("\nBest Move (rating: ", score, "): ");
+  print_move(bestMove);
 
-  for (size_t i = 0; i < Depth; i++)
+  print("\nBest move combination for white (rating: ", cache.highestScore, "):\n");
+
+  for (size_t i = 0; i < cache.highestMoveCount; i++)
   {
     print_move(cache.highestMove[i]);
     print(", ");
   }
 
-  print("\nBest move combination for black (rating: ", cache.lowestScore.score, " at depth: ", cache.lowestScore.depth, "):\n");
+  print("\nBest move combination for black (rating: ", cache.lowestScore, "):\n");
 
-  for (size_t i = 0; i < Depth; i++)
+  for (size_t i = 0; i < cache.lowestMoveCount; i++)
   {
     print_move(cache.lowestMove[i]);
     print(", ");
@@ -1870,23 +4126,159 @@ chess_move get_complex_move(const chess_board &board)
 
   print("\nRating Distribution:\n");
 
-  for (size_t i = 0; i < Depth; i++)
-    print(cache.stepMin[i].score, " ~ ", cache.stepMax[i].score, ", ");
+  for (size_t i = 0; i < depth; i++)
+    print(cache.stepMin[i], " ~ ", cache.stepMax[i], ", ");
 
   print('\n');
+#else
+  (void)score;
 #endif
 
-  return moveInfo.moves[0];
+  return bestMove;
+}
+
+chess_move get_complex_move_white(const chess_board &board, const chess_history *pHistory, const search_limits *pLimits, _Out_opt_ search_result *pResult)
+{
+  return get_complex_move<true>(board, pHistory, pLimits, pResult);
+}
+
+chess_move get_complex_move_black(const chess_board &board, const chess_history *pHistory, const search_limits *pLimits, _Out_opt_ search_result *pResult)
+{
+  return get_complex_move<false>(board, pHistory, pLimits, pResult);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+search_limits get_skill_level_limits(const size_t skillLevel)
+{
+  search_limits limits;
+  limits.maxDepth = MaxSearchDepth;
+  limits.maxNodes = SkillLevelMinNodes << lsMin(skillLevel, MaxSkillLevel);
+
+  return limits;
+}
+
+static const char *_BenchPositions[] =
+{
+  "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w",
+  "r3kb1r/ppp1pppp/n4n2/4Q3/5B2/2N1KP2/PPP3qP/3R2NR w",
+  "rnbqk1nr/pppp1ppp/8/4p3/4PP2/2N5/PPPP2PP/R1BQKBR1 b",
+  "r2q1b1r/2p1kpp1/ppQp1n2/3PP1p1/8/8/PPP3PP/RN3RK1 w",
+  "r1q2r2/pbb2p2/1p3knQ/2p2p2/8/2PP4/PP4PP/RNB1R1K1 w",
+  "r1bqkb1r/pppp1ppp/2n2n2/4p3/2B1P3/5N2/PPPP1PPP/RNBQK2R w",
+  "8/5pk1/6p1/3P4/5P2/6P1/5K2/8 w",
+  "2r3k1/1q3ppp/p3p3/1p1nP3/3Q4/P4N2/1P3PPP/3R2K1 b",
+};
+
+// Each position is searched from an empty transposition table (and search thread caches), so as long as the limits don't involve time (or multiple threads), the node counts (and with them the best moves and scores) only change if the search does.
+static lsResult search_bench(const search_limits &limits, _Out_opt_ size_t *pTotalNodes)
+{
+  lsResult result = lsR_Success;
+
+  lsAssert(limits.maxTimeMs == 0 && limits.softDeadlineNs == 0 && limits.hardDeadlineNs == 0 && limits.pStop == nullptr);
+
+  size_t totalNodes = 0;
+  const int64_t before = lsGetCurrentTimeNs();
+
+  if (_TranspositionTable.pEntries == nullptr)
+    LS_ERROR_CHECK(transposition_table_create());
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(_BenchPositions); i++)
+  {
+    const chess_board board = get_board_from_fen(_BenchPositions[i]);
+    search_result searchResult;
+
+    transposition_table_clear();
+    search_caches_clear();
+
+    if (board.isWhitesTurn)
+      get_complex_move_white(board, nullptr, &limits, &searchResult);
+    else
+      get_complex_move_black(board, nullptr, &limits, &searchResult);
+
+    totalNodes += searchResult.nodes;
+
+    print("Bench ", i + 1, " / ", LS_ARRAYSIZE(_BenchPositions), ": ");
+    print_move(searchResult.lines[0].pv[0]);
+    print(" (rating: ", searchResult.lines[0].score, ", depth: ", searchResult.depth, ", nodes: ", FU(Group)(searchResult.nodes), ")\n");
+  }
+
+  {
+    const int64_t after = lsGetCurrentTimeNs();
+    print("Bench: ", FU(Group)(totalNodes), " nodes in ", FF(Max(5))((after - before) * 1e-9f), "s (", FF(Max(9), Group)(totalNodes / lsMax(1e-9f, (after - before) * 1e-9f)), "/s)\n");
+  }
+
+  if (pTotalNodes != nullptr)
+    *pTotalNodes = totalNodes;
+
+epilogue:
+  return result;
 }
 
-chess_move get_complex_move_white(const chess_board &board)
+lsResult run_search_bench(const search_limits &limits, _Out_opt_ size_t *pTotalNodes)
 {
-  return get_complex_move<true>(board);
+  lsResult result = lsR_Success;
+
+  LS_ERROR_IF(limits.threads > 1, lsR_InvalidParameter); // the node counts of parallel searches vary from run to run.
+  LS_ERROR_CHECK(search_bench(limits, pTotalNodes));
+
+epilogue:
+  return result;
 }
 
-chess_move get_complex_move_black(const chess_board &board)
+// Reports how long reaching `depth` on the bench positions takes with increasingly many threads sharing the work as `mode` says, and how many more nodes that takes than with one thread.
+// Other modes are compared to Lazy SMP with the same number of threads, which is measured as well.
+lsResult run_parallel_search_bench(const size_t depth, const search_parallel_mode mode)
 {
-  return get_complex_move<false>(board);
+  lsResult result = lsR_Success;
+
+  constexpr size_t ThreadCounts[] = { 1, 2, 4, 8, 16, 32 };
+  const bool compareToLazySmp = mode != spm_lazy_smp;
+  int64_t durationNs[2][LS_ARRAYSIZE(ThreadCounts)] = {}; // [isLazySmpReference][threadCountIndex]
+  size_t nodes[2][LS_ARRAYSIZE(ThreadCounts)] = {};
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(ThreadCounts); i++)
+  {
+    for (size_t reference = 0; reference < (compareToLazySmp ? 2 : 1); reference++)
+    {
+      // a single thread searches the same way in every mode.
+      if (reference && i == 0)
+      {
+        durationNs[reference][i] = durationNs[0][i];
+        nodes[reference][i] = nodes[0][i];
+        continue;
+      }
+
+      search_limits limits;
+      limits.maxDepth = depth;
+      limits.threads = ThreadCounts[i];
+      limits.parallelMode = reference ? spm_lazy_smp : mode;
+
+      const int64_t before = lsGetCurrentTimeNs();
+      LS_ERROR_CHECK(search_bench(limits, &nodes[reference][i]));
+      durationNs[reference][i] = lsGetCurrentTimeNs() - before;
+    }
+  }
+
+  print("\nTime to depth ", depth, " (", thread_pool_max_threads(), " hardware threads):\n");
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(ThreadCounts); i++)
+  {
+    for (size_t reference = 0; reference < (compareToLazySmp ? 2 : 1); reference++)
+    {
+      if (reference)
+        print(", Lazy SMP: ");
+      else
+        print(ThreadCounts[i], " threads: ");
+
+      print(FF(Max(5))(durationNs[reference][i] * 1e-9f), "s, speedup: ", FF(Max(5))((float_t)durationNs[reference][0] / lsMax((int64_t)1, durationNs[reference][i])), "x, nodes: ", FU(Group)(nodes[reference][i]), " (", FF(Max(5))((nodes[reference][i] * 100.f) / lsMax((size_t)1, nodes[reference][0])), "%)");
+    }
+
+    print('\n');
+  }
+
+epilogue:
+  return result;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -2062,23 +4454,118 @@ epilogue:
   return result;
 }
 
-DEFINE_TESTABLE(score_with_depth_operator_test)
+DEFINE_TESTABLE(mate_score_test)
+{
+  lsResult result = lsR_Success;
+
+  // Quicker wins score higher, slower losses score higher than quick ones.
+  TESTABLE_ASSERT_TRUE(MateScore - 1 > MateScore - 3);
+  TESTABLE_ASSERT_TRUE(-MateScore + 3 > -MateScore + 1);
+  TESTABLE_ASSERT_TRUE(is_mate_score(MateScore - (int32_t)MaxSearchPly));
+  TESTABLE_ASSERT_TRUE(is_mate_score(-MateScore + (int32_t)MaxSearchPly));
+  TESTABLE_ASSERT_TRUE(!is_mate_score((int32_t)PieceScores[cpT_queen] * 9));
+
+  // Mate scores are stored relative to the storing node, so they stay correct when read at a different ply.
+  TESTABLE_ASSERT_EQUAL(transposition_table_score_to_entry(MateScore - 5, 3), MateScore - 2);
+  TESTABLE_ASSERT_EQUAL(transposition_table_score_from_entry(MateScore - 2, 1), MateScore - 3);
+  TESTABLE_ASSERT_EQUAL(transposition_table_score_to_entry(-MateScore + 5, 3), -MateScore + 2);
+  TESTABLE_ASSERT_EQUAL(transposition_table_score_from_entry(-MateScore + 2, 1), -MateScore + 3);
+  TESTABLE_ASSERT_EQUAL(transposition_table_score_from_entry(transposition_table_score_to_entry(123, 7), 2), 123);
+
+epilogue:
+  return result;
+}
+
+DEFINE_TESTABLE(repetition_hash_test)
+{
+  lsResult result = lsR_Success;
+
+  const chess_board start = chess_board::get_starting_point();
+  chess_board board = start;
+  chess_history history;
+
+  const chess_move knightMoves[] = {
+    chess_move(vec2i8(6, 0), vec2i8(5, 2), cmt_knight),
+    chess_move(vec2i8(6, 7), vec2i8(5, 5), cmt_knight),
+    chess_move(vec2i8(5, 2), vec2i8(6, 0), cmt_knight),
+    chess_move(vec2i8(5, 5), vec2i8(6, 7), cmt_knight),
+  };
+
+  for (const chess_move move : knightMoves)
+  {
+    TESTABLE_ASSERT_SUCCESS(chess_history_add(history, board));
+    board = perform_move(board, move);
+  }
+
+  TESTABLE_ASSERT_EQUAL(board.hash, start.hash);
+  TESTABLE_ASSERT_EQUAL((size_t)board.halfMoveClock, (size_t)4);
+  TESTABLE_ASSERT_EQUAL(history.hashes.count, (size_t)4);
+  TESTABLE_ASSERT_EQUAL(history.hashes[0], start.hash);
+
+  // A pawn move is irreversible, so everything before it is dropped from the history.
+  TESTABLE_ASSERT_SUCCESS(chess_history_add(history, board));
+  board = perform_move(board, chess_move(vec2i8(4, 1), vec2i8(4, 3), cmt_pawn_double_step));
+  TESTABLE_ASSERT_EQUAL((size_t)board.halfMoveClock, (size_t)0);
+
+  TESTABLE_ASSERT_SUCCESS(chess_history_add(history, board));
+  TESTABLE_ASSERT_EQUAL(history.hashes.count, (size_t)1);
+
+epilogue:
+  return result;
+}
+
+DEFINE_TESTABLE(static_exchange_evaluation_test)
 {
   lsResult result = lsR_Success;
 
-  TESTABLE_ASSERT_TRUE(score_with_depth(1, 1) < score_with_depth(1, 2));
-  TESTABLE_ASSERT_TRUE(score_with_depth(1, 1) < score_with_depth(2, 1));
+  const chess_board undefended = get_board_from_fen("1k1r4/1pp4p/p7/4p3/8/P5P1/1PP4P/2K1R3 w");
+  const chess_board defended = get_board_from_fen("1k1r3q/1ppn3p/p4b2/4p3/8/P2N2P1/1PP1R1BP/2K1Q3 w");
+  const chess_board xray = get_board_from_fen("3rk3/3r4/8/3p4/8/8/3R4/3RK3 w");
+  const chess_board xrayDefender = get_board_from_fen("3rk3/8/8/3p4/8/8/3R4/3RK3 w");
 
-  TESTABLE_ASSERT_TRUE(score_with_depth(1, 1) <= score_with_depth(1, 2));
-  TESTABLE_ASSERT_TRUE(score_with_depth(1, 1) <= score_with_depth(1, 1));
-  TESTABLE_ASSERT_TRUE(score_with_depth(1, 1) <= score_with_depth(2, 1));
+  // An undefended pawn is simply won.
+  TESTABLE_ASSERT_EQUAL(static_exchange_evaluation(undefended, chess_move(vec2i8(4, 0), vec2i8(4, 4), cmt_rook)), PieceScores[cpT_pawn]);
 
-  TESTABLE_ASSERT_TRUE(score_with_depth(1, 1) > score_with_depth(1, 2));
-  TESTABLE_ASSERT_TRUE(score_with_depth(2, 1) > score_with_depth(1, 2));
+  // The knight is lost for a pawn, even though the rook, queen and bishop behind it take part in the exchange.
+  TESTABLE_ASSERT_EQUAL(static_exchange_evaluation(defended, chess_move(vec2i8(3, 2), vec2i8(4, 4), cmt_knight)), PieceScores[cpT_pawn] - PieceScores[cpT_knight]);
+
+  // The doubled rooks on both sides only see the pawn through the rook in front of them (x-ray), so taking it loses a rook.
+  TESTABLE_ASSERT_EQUAL(static_exchange_evaluation(xray, chess_move(vec2i8(3, 1), vec2i8(3, 4), cmt_rook)), PieceScores[cpT_pawn] - PieceScores[cpT_rook]);
+
+  // With a single defender, the rook behind the attacking one wins the exchange.
+  TESTABLE_ASSERT_EQUAL(static_exchange_evaluation(xrayDefender, chess_move(vec2i8(3, 1), vec2i8(3, 4), cmt_rook)), PieceScores[cpT_pawn]);
+
+epilogue:
+  return result;
+}
+
+DEFINE_TESTABLE(node_limited_search_determinism_test)
+{
+  lsResult result = lsR_Success;
+
+  // With the same node budget, transposition table and caches, a search has to end up with the same result, or skill levels wouldn't be reproducible.
+  const chess_board board = get_board_from_fen("2r3k1/1q3ppp/p3p3/1p1nP3/3Q4/P4N2/1P3PPP/3R2K1 b");
+
+  search_limits limits;
+  limits.maxDepth = MaxSearchDepth;
+  limits.maxNodes = 20000;
+
+  search_result results[2];
+  chess_move moves[2];
+
+  for (size_t i = 0; i < LS_ARRAYSIZE(results); i++)
+  {
+    transposition_table_clear();
+    search_caches_clear();
+
+    moves[i] = get_complex_move_black(board, nullptr, &limits, &results[i]);
+  }
 
-  TESTABLE_ASSERT_TRUE(score_with_depth(1, 1) >= score_with_depth(1, 2));
-  TESTABLE_ASSERT_TRUE(score_with_depth(1, 1) >= score_with_depth(1, 1));
-  TESTABLE_ASSERT_TRUE(score_with_depth(2, 1) >= score_with_depth(1, 1));
+  TESTABLE_ASSERT_EQUAL(results[0].nodes, results[1].nodes);
+  TESTABLE_ASSERT_EQUAL(results[0].depth, results[1].depth);
+  TESTABLE_ASSERT_EQUAL(moves[0], moves[1]);
+  TESTABLE_ASSERT_EQUAL(results[0].lines[0].pv[0], results[1].lines[0].pv[0]);
+  TESTABLE_ASSERT_EQUAL(results[0].lines[0].score, results[1].lines[0].score);
 
 epilogue:
   return result;
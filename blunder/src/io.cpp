@@ -2,6 +2,12 @@
 
 #include "shlwapi.h"
 
+#ifndef LS_PLATFORM_WINDOWS
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
+
 //////////////////////////////////////////////////////////////////////////
 
 lsResult lsReadFileBytes(const char *filename, uint8_t **ppData, const size_t elementSize, size_t *pCount)
@@ -213,6 +219,84 @@ epilogue:
 
 //////////////////////////////////////////////////////////////////////////
 
+lsResult lsMapFileBytes(const char *filename, _Out_ uint8_t **ppData, _Out_ size_t *pSize)
+{
+  lsResult result = lsR_Success;
+
+#ifndef LS_PLATFORM_WINDOWS
+  int32_t fileDescriptor = -1;
+  struct stat fileStat;
+  void *pView = MAP_FAILED;
+#else
+  HANDLE fileHandle = INVALID_HANDLE_VALUE;
+  HANDLE mappingHandle = nullptr;
+  LARGE_INTEGER fileSize;
+  void *pView = nullptr;
+#endif
+
+  LS_ERROR_IF(filename == nullptr || ppData == nullptr || pSize == nullptr, lsR_ArgumentNull);
+
+#ifndef LS_PLATFORM_WINDOWS
+  fileDescriptor = open(filename, O_RDONLY);
+  LS_ERROR_IF(fileDescriptor == -1, lsR_ResourceNotFound);
+
+  LS_ERROR_IF(0 != fstat(fileDescriptor, &fileStat), lsR_IOFailure);
+  LS_ERROR_IF(fileStat.st_size == 0, lsR_EndOfStream);
+
+  pView = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fileDescriptor, 0);
+  LS_ERROR_IF(pView == MAP_FAILED, lsR_IOFailure);
+
+  *ppData = reinterpret_cast<uint8_t *>(pView);
+  *pSize = (size_t)fileStat.st_size;
+#else
+  fileHandle = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  LS_ERROR_IF(fileHandle == INVALID_HANDLE_VALUE, lsR_ResourceNotFound);
+
+  LS_ERROR_IF(0 == GetFileSizeEx(fileHandle, &fileSize), lsR_IOFailure);
+  LS_ERROR_IF(fileSize.QuadPart == 0, lsR_EndOfStream);
+
+  mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+  LS_ERROR_IF(mappingHandle == nullptr, lsR_IOFailure);
+
+  pView = MapViewOfFile(mappingHandle, FILE_MAP_COPY, 0, 0, 0);
+  LS_ERROR_IF(pView == nullptr, lsR_IOFailure);
+
+  *ppData = reinterpret_cast<uint8_t *>(pView);
+  *pSize = (size_t)fileSize.QuadPart;
+#endif
+
+epilogue:
+#ifndef LS_PLATFORM_WINDOWS
+  if (fileDescriptor != -1)
+    close(fileDescriptor); // The mapping keeps the file alive.
+#else
+  if (mappingHandle != nullptr)
+    CloseHandle(mappingHandle); // The view keeps the mapping alive.
+
+  if (fileHandle != INVALID_HANDLE_VALUE)
+    CloseHandle(fileHandle);
+#endif
+
+  return result;
+}
+
+void lsUnmapFileBytes(_In_Out_ uint8_t **ppData, const size_t size)
+{
+  if (ppData == nullptr || *ppData == nullptr)
+    return;
+
+#ifndef LS_PLATFORM_WINDOWS
+  munmap(*ppData, size);
+#else
+  (void)size;
+  UnmapViewOfFile(*ppData);
+#endif
+
+  *ppData = nullptr;
+}
+
+//////////////////////////////////////////////////////////////////////////
+
 #ifdef LS_PLATFORM_WINDOWS
 bool lsFileExists(const char *filename)
 {
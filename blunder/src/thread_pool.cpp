@@ -111,6 +111,7 @@ void thread_pool_destroy(thread_pool **ppThreadPool)
     return;
 
   delete *ppThreadPool;
+  *ppThreadPool = nullptr;
 }
 
 size_t thread_pool_thread_count(thread_pool *pPool)
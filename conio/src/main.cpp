@@ -16,8 +16,17 @@ enum ai_type
   ait_complex,
 };
 
+static size_t _MultiPvLines = 1; // the complex AI prints this many of its best lines before playing.
+static std::optional<size_t> _SkillLevel; // limits the complex AI to the node budget of this skill level.
+static size_t _SearchThreads = 1;
+static search_parallel_mode _ParallelMode = spm_lazy_smp;
+
+constexpr size_t BenchDepth = 8;
+
+//////////////////////////////////////////////////////////////////////////
+
 template <bool IsWhite>
-void perform_move(chess_board &board, list<chess_move> &moves, const ai_type from_input);
+void perform_move(chess_board &board, chess_history &history, list<chess_move> &moves, const ai_type from_input);
 
 void print_board(const chess_board &board);
 char read_char();
@@ -43,6 +52,8 @@ int32_t main(const int32_t argc, char **pArgv)
   ai_type black_player = ait_complex;
 
   bool runTests = false;
+  bool runBench = false;
+  bool runParallelBench = false;
 
   for (size_t i = 1; i < (size_t)argc; i++)
   {
@@ -68,6 +79,20 @@ int32_t main(const int32_t argc, char **pArgv)
       black_player = ait_complex;
     else if (lsStringEquals("--run-tests", pArgv[i]))
       runTests = true;
+    else if (lsStringEquals("--multi-pv", pArgv[i]) && i + 1 < (size_t)argc)
+      _MultiPvLines = lsClamp((size_t)lsParseUInt(pArgv[++i]), (size_t)1, MaxMultiPv);
+    else if (lsStringEquals("--skill", pArgv[i]) && i + 1 < (size_t)argc)
+      _SkillLevel = lsMin((size_t)lsParseUInt(pArgv[++i]), MaxSkillLevel);
+    else if (lsStringEquals("--bench", pArgv[i]))
+      runBench = true;
+    else if (lsStringEquals("--parallel-bench", pArgv[i]))
+      runParallelBench = true;
+    else if (lsStringEquals("--threads", pArgv[i]) && i + 1 < (size_t)argc)
+      _SearchThreads = lsClamp((size_t)lsParseUInt(pArgv[++i]), (size_t)1, MaxSearchThreads);
+    else if (lsStringEquals("--root-split", pArgv[i]))
+      _ParallelMode = spm_root_split;
+    else if (lsStringEquals("--abdada", pArgv[i]))
+      _ParallelMode = spm_abdada;
     else if (LS_FAILED(read_start_position_from_file(pArgv[i], board)))
       lsFail();
   }
@@ -105,17 +130,34 @@ int32_t main(const int32_t argc, char **pArgv)
   if (runTests)
     run_testables();
 
+  if (runBench)
+  {
+    search_limits limits;
+    limits.maxDepth = BenchDepth;
+
+    return LS_FAILED(run_search_bench(limits)) ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  if (runParallelBench)
+  {
+    const lsResult result = run_parallel_search_bench(BenchDepth, _ParallelMode);
+    search_thread_pool_destroy();
+
+    return LS_FAILED(result) ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
   list<chess_move> moves;
+  chess_history history;
   print_board(board);
 
   while (true)
   {
-    perform_move<true>(board, moves, white_player);
+    perform_move<true>(board, history, moves, white_player);
 
     if (board.hasWhiteWon)
       break;
 
-    perform_move<false>(board, moves, black_player);
+    perform_move<false>(board, history, moves, black_player);
 
     if (board.hasBlackWon)
       break;
@@ -217,8 +259,10 @@ chess_move get_move_from_input(const chess_board &board, list<chess_move> &moves
 }
 
 template <bool IsWhite>
-void perform_move(chess_board &board, list<chess_move> &moves, const ai_type ai)
+void perform_move(chess_board &board, chess_history &history, list<chess_move> &moves, const ai_type ai)
 {
+  const chess_board previousBoard = board;
+
   switch (ai)
   {
   default:
@@ -265,9 +309,9 @@ void perform_move(chess_board &board, list<chess_move> &moves, const ai_type ai)
     chess_move move;
 
     if constexpr (IsWhite)
-      move = get_alpha_beta_move_white(board);
+      move = get_alpha_beta_move_white(board, &history);
     else
-      move = get_alpha_beta_move_black(board);
+      move = get_alpha_beta_move_black(board, &history);
 
     board = perform_move(board, move);
     print_played_move(move);
@@ -278,11 +322,34 @@ void perform_move(chess_board &board, list<chess_move> &moves, const ai_type ai)
   case ait_complex:
   {
     chess_move move;
+    search_limits limits = _SkillLevel.has_value() ? get_skill_level_limits(_SkillLevel.value()) : search_limits();
+    limits.multiPv = _MultiPvLines;
+    limits.threads = _SearchThreads;
+    limits.parallelMode = _ParallelMode;
+    search_result result;
 
     if constexpr (IsWhite)
-      move = get_complex_move_white(board);
+      move = get_complex_move_white(board, &history, &limits, &result);
     else
-      move = get_complex_move_black(board);
+      move = get_complex_move_black(board, &history, &limits, &result);
+
+    if (_MultiPvLines > 1)
+    {
+      for (size_t i = 0; i < result.lineCount; i++)
+      {
+        print("Line ", i + 1, " (rating: ", result.lines[i].score, "):");
+
+        for (size_t j = 0; j < result.lines[i].pvLength; j++)
+        {
+          print(' ');
+          print_move(result.lines[i].pv[j]);
+        }
+
+        print('\n');
+      }
+
+      print('\n');
+    }
 
     board = perform_move(board, move);
     print_played_move(move);
@@ -291,6 +358,12 @@ void perform_move(chess_board &board, list<chess_move> &moves, const ai_type ai)
   }
   }
 
+  if (LS_FAILED(chess_history_add(history, previousBoard)))
+  {
+    print_error_line("Failed to record game history. Aborting.");
+    exit(EXIT_FAILURE);
+  }
+
   print_board(board);
 }
 
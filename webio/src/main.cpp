@@ -2,6 +2,7 @@
 #include <exception>
 #include <stdlib.h>
 #include <malloc.h>
+#include <mutex>
 
 #define ASIO_STANDALONE 1
 #define ASIO_NO_EXCEPTIONS 1
@@ -51,17 +52,42 @@ namespace asio
 
 #include "core.h"
 #include "blunder.h"
+#include "thread_pool.h"
 
 //////////////////////////////////////////////////////////////////////////
 
 crow::response handle_get_board(const crow::request &req);
 crow::response handle_get_valid_moves(const crow::request &req);
 crow::response handle_move(const crow::request &req);
+crow::response handle_analyze(const crow::request &req);
 crow::response handle_restart(const crow::request &req);
+crow::response handle_save_transposition_table(const crow::request &req);
+
+// Both must only be called while holding `_SearchMutex`.
+lsResult ponder_start(const chess_move expectedReply);
+void ponder_stop();
 
 //////////////////////////////////////////////////////////////////////////
 
 static chess_board _CurrentBoard = chess_board::get_starting_point();
+static chess_history _History;
+static const char _TranspositionTableSnapshotFilename[] = "transposition_table.bin";
+static const int64_t _AiMoveTimeMs = 2500; // keeps the response time of `/move` predictable, regardless of how complex the position is.
+static size_t _SearchThreads = 1; // all hardware threads, set on startup.
+
+// crow runs handlers concurrently, but searches and transposition table snapshots must not overlap, as saving a snapshot may release the table memory a search is using.
+// Held by every handler that uses the game or ponder state as well, as the ponder search may only be started and stopped by one of them at a time.
+static std::mutex _SearchMutex;
+
+// While the user thinks, the AI already searches its answer to the reply it expects (the second move of its principal variation).
+static const int64_t _MaxPonderTimeMs = 60 * 1000; // pondering uses all hardware threads, so don't keep them busy forever if the user walked away.
+static thread_pool *_pPonderThreadPool = nullptr;
+static std::atomic<bool> _PonderStop = false;
+static bool _IsPondering = false; // the ponder state is guarded by `_SearchMutex`, apart from the ponder search itself, which only runs while `_IsPondering` is set.
+static int64_t _PonderStartNs = 0;
+static chess_board _PonderBoard; // the position after the expected reply.
+static chess_history _PonderHistory;
+static search_result _PonderResult;
 
 //////////////////////////////////////////////////////////////////////////
 
@@ -110,6 +136,24 @@ int32_t main(const int32_t argc, const char **pArgv)
 
   starting_hash_boards_create();
 
+  if (LS_FAILED(transposition_table_create()))
+  {
+    print_error_line("Failed to allocate transposition table.");
+    return EXIT_FAILURE;
+  }
+
+  if (LS_FAILED(transposition_table_load(_TranspositionTableSnapshotFilename)))
+    print_log_line("No usable transposition table snapshot found. Starting with an empty transposition table.");
+
+  _SearchThreads = lsClamp(thread_pool_max_threads(), (size_t)1, MaxSearchThreads);
+  _pPonderThreadPool = thread_pool_new(1);
+
+  if (_pPonderThreadPool == nullptr)
+  {
+    print_error_line("Failed to create ponder thread.");
+    return EXIT_FAILURE;
+  }
+
   {
     crow::App<crow::CORSHandler> app;
 
@@ -123,11 +167,22 @@ int32_t main(const int32_t argc, const char **pArgv)
     CROW_ROUTE(app, "/get_board").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_get_board(req); });
     CROW_ROUTE(app, "/get_valid_moves").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_get_valid_moves(req); });
     CROW_ROUTE(app, "/move").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_move(req); });
+    CROW_ROUTE(app, "/analyze").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_analyze(req); });
     CROW_ROUTE(app, "/restart").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_restart(req); });
+    CROW_ROUTE(app, "/save_transposition_table").methods(crow::HTTPMethod::POST)([](const crow::request &req) { return handle_save_transposition_table(req); });
 
     app.port(21110).multithreaded().run();
   }
 
+  ponder_stop();
+  thread_pool_destroy(&_pPonderThreadPool);
+  search_thread_pool_destroy();
+
+  if (LS_FAILED(transposition_table_save(_TranspositionTableSnapshotFilename)))
+    print_error_line("Failed to save transposition table snapshot.");
+
+  transposition_table_destroy();
+
   return EXIT_SUCCESS;
 }
 
@@ -137,6 +192,8 @@ crow::response handle_get_board(const crow::request &req)
 {
   (void)req;
 
+  std::lock_guard<std::mutex> lock(_SearchMutex);
+
   crow::json::wvalue ret;
 
   ret["isWhitesTurn"] = _CurrentBoard.isWhitesTurn;
@@ -165,6 +222,8 @@ crow::response handle_get_valid_moves(const crow::request &req)
 {
   (void)req;
 
+  std::lock_guard<std::mutex> lock(_SearchMutex);
+
   crow::json::wvalue ret;
 
   list<chess_move> moves;
@@ -192,6 +251,8 @@ crow::response handle_get_valid_moves(const crow::request &req)
 
 crow::response handle_move(const crow::request &req)
 {
+  std::lock_guard<std::mutex> lock(_SearchMutex);
+
   auto body = crow::json::load(req.body);
 
   if (!body || !body.has("originX") || !body.has("originY") || !body.has("destinationX") || !body.has("destinationY") || !body.has("isPromotion"))
@@ -233,25 +294,196 @@ crow::response handle_move(const crow::request &req)
   }
 
   // Perform move.
+  if (LS_FAILED(chess_history_add(_History, _CurrentBoard)))
+    return crow::response(crow::status::INTERNAL_SERVER_ERROR);
+
   _CurrentBoard = perform_move(_CurrentBoard, chosenMove.value());
 
   // AI move.
   {
-    const chess_move move = get_alpha_beta_move_black(_CurrentBoard);
+    const bool isPonderHit = _IsPondering && _PonderBoard.hash == _CurrentBoard.hash;
+    const int64_t ponderedMs = isPonderHit ? (lsGetCurrentTimeNs() - _PonderStartNs) / (1000 * 1000) : 0;
+
+    ponder_stop();
+
+    search_result result;
+
+    // If the ponder search had as much time as a regular search would get to start its last iteration, its move is played right away.
+    // Otherwise the regular search only gets the remaining time, as it profits from the transposition table entries of the ponder search.
+    if (isPonderHit && ponderedMs >= _AiMoveTimeMs / 2)
+    {
+      result = _PonderResult;
+    }
+    else
+    {
+      search_limits limits;
+      limits.maxDepth = MaxSearchDepth;
+      limits.maxTimeMs = lsMax(_AiMoveTimeMs - ponderedMs, _AiMoveTimeMs / 4);
+      limits.threads = _SearchThreads;
+      limits.parallelMode = spm_root_split; // too short for the helper threads of Lazy SMP to catch up.
+
+      get_complex_move_black(_CurrentBoard, &_History, &limits, &result);
+    }
+
+    const chess_move move = result.lines[0].pv[0];
+
+    if (LS_FAILED(chess_history_add(_History, _CurrentBoard)))
+      return crow::response(crow::status::INTERNAL_SERVER_ERROR);
+
     _CurrentBoard = perform_move(_CurrentBoard, move);
+
+    if (result.lines[0].pvLength > 1 && LS_FAILED(ponder_start(result.lines[0].pv[1])))
+      print_error_line("Failed to start pondering.");
   }
 
   return crow::response(crow::status::OK);
 }
 
+// Returns the best `lines` (default 3, up to `MaxMultiPv`) lines for the side to move without performing a move.
+crow::response handle_analyze(const crow::request &req)
+{
+  std::lock_guard<std::mutex> lock(_SearchMutex);
+
+  auto body = crow::json::load(req.body);
+
+  if (!body)
+    return crow::response(crow::status::BAD_REQUEST);
+
+  size_t lineCount = 3;
+
+  if (body.has("lines"))
+  {
+    const int64_t lines = body["lines"].i();
+
+    if (lines < 1 || lines > (int64_t)MaxMultiPv)
+      return crow::response(crow::status::BAD_REQUEST);
+
+    lineCount = (size_t)lines;
+  }
+
+  if (_CurrentBoard.hasWhiteWon || _CurrentBoard.hasBlackWon)
+    return crow::response(crow::status::BAD_REQUEST);
+
+  ponder_stop(); // both would share the transposition table and a core.
+
+  search_limits limits;
+  limits.maxDepth = MaxSearchDepth;
+  limits.maxTimeMs = _AiMoveTimeMs;
+  limits.multiPv = lineCount;
+  limits.threads = _SearchThreads;
+
+  search_result result;
+
+  if (_CurrentBoard.isWhitesTurn)
+    get_complex_move_white(_CurrentBoard, &_History, &limits, &result);
+  else
+    get_complex_move_black(_CurrentBoard, &_History, &limits, &result);
+
+  crow::json::wvalue ret;
+
+  ret["depth"] = result.depth;
+
+  for (uint32_t i = 0; i < result.lineCount; i++)
+  {
+    const search_line &line = result.lines[i];
+
+    ret["lines"][i]["score"] = line.score;
+
+    for (uint32_t j = 0; j < line.pvLength; j++)
+    {
+      const chess_move move = line.pv[j];
+
+      ret["lines"][i]["moves"][j]["originX"] = move.startX;
+      ret["lines"][i]["moves"][j]["originY"] = move.startY;
+      ret["lines"][i]["moves"][j]["destinationX"] = move.targetX;
+      ret["lines"][i]["moves"][j]["destinationY"] = move.targetY;
+      ret["lines"][i]["moves"][j]["isPromotion"] = move.isPromotion;
+
+      if (move.isPromotion)
+        ret["lines"][i]["moves"][j]["isPromotionToQueen"] = move.isPromotedToQueen;
+    }
+  }
+
+  return ret;
+}
+
 crow::response handle_restart(const crow::request &req)
 {
   auto body = crow::json::load(req.body);
 
+  std::lock_guard<std::mutex> lock(_SearchMutex);
+
+  ponder_stop();
+
   if (!body || !body.has("type") || body["type"].s() == "default")
     _CurrentBoard = chess_board::get_starting_point();
   else
     return crow::response(crow::status::NOT_FOUND);
 
+  chess_history_clear(_History);
+
   return crow::response(crow::status::OK);
 }
+
+crow::response handle_save_transposition_table(const crow::request &req)
+{
+  (void)req;
+
+  std::lock_guard<std::mutex> lock(_SearchMutex);
+
+  ponder_stop(); // the snapshot must not be written to while it's being saved.
+
+  if (LS_FAILED(transposition_table_save(_TranspositionTableSnapshotFilename)))
+    return crow::response(crow::status::INTERNAL_SERVER_ERROR);
+
+  return crow::response(crow::status::OK);
+}
+
+//////////////////////////////////////////////////////////////////////////
+
+lsResult ponder_start(const chess_move expectedReply)
+{
+  lsResult result = lsR_Success;
+
+  lsAssert(!_IsPondering);
+
+  _PonderBoard = perform_move(_CurrentBoard, expectedReply);
+
+  // the game is over after the reply, so there's nothing to ponder on.
+  if (_PonderBoard.hasWhiteWon || _PonderBoard.hasBlackWon)
+    goto epilogue;
+
+  chess_history_clear(_PonderHistory);
+  LS_ERROR_CHECK(list_add_range(&_PonderHistory.hashes, _History.hashes.pValues, _History.hashes.count));
+  LS_ERROR_CHECK(chess_history_add(_PonderHistory, _CurrentBoard));
+
+  _PonderStop = false;
+  _PonderStartNs = lsGetCurrentTimeNs();
+  _IsPondering = true;
+
+  thread_pool_add(_pPonderThreadPool, []()
+    {
+      search_limits limits;
+      limits.maxDepth = MaxSearchDepth;
+      limits.maxTimeMs = _MaxPonderTimeMs;
+      limits.pStop = &_PonderStop;
+      limits.threads = _SearchThreads;
+      limits.parallelMode = spm_abdada; // pondering runs long enough for the threads to split the work of the whole tree.
+
+      get_complex_move_black(_PonderBoard, &_PonderHistory, &limits, &_PonderResult);
+    });
+
+epilogue:
+  return result;
+}
+
+// Aborts the ponder search if there is one and waits for it, so `_PonderResult` holds its last completed iteration.
+void ponder_stop()
+{
+  if (!_IsPondering)
+    return;
+
+  _PonderStop = true;
+  thread_pool_await(_pPonderThreadPool);
+  _IsPondering = false;
+}